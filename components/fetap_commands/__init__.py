@@ -0,0 +1,126 @@
+from esphome import automation
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.const import (
+    CONF_COMMAND,
+    CONF_ID,
+    CONF_MICROPHONE,
+    CONF_NAME,
+    CONF_THRESHOLD,
+    CONF_TRIGGER_ID,
+)
+
+DEPENDENCIES = ["microphone"]
+
+CONF_COMMANDS = "commands"
+CONF_ON_DETECTED = "on_detected"
+CONF_ON_UNRECOGNIZED = "on_unrecognized"
+
+fetap_ns = cg.esphome_ns.namespace("fetap")
+FetapCommands = fetap_ns.class_("FetapCommands", cg.Component)
+FetapMicrophone = fetap_ns.class_("FetapMicrophone", cg.Component)
+
+FetapCommandsStartAction = fetap_ns.class_(
+    "FetapCommandsStartAction", automation.Action, cg.Parented.template(FetapCommands)
+)
+FetapCommandsStopAction = fetap_ns.class_(
+    "FetapCommandsStopAction", automation.Action, cg.Parented.template(FetapCommands)
+)
+FetapCommandsEnrollAction = fetap_ns.class_(
+    "FetapCommandsEnrollAction", automation.Action, cg.Parented.template(FetapCommands)
+)
+FetapCommandsIsListeningCondition = fetap_ns.class_(
+    "FetapCommandsIsListeningCondition", automation.Condition, cg.Parented.template(FetapCommands)
+)
+
+
+def validate_unique_names(commands):
+    names = [command[CONF_NAME] for command in commands]
+    for name in names:
+        if names.count(name) > 1:
+            raise cv.Invalid(f"Command '{name}' is configured more than once")
+    return commands
+
+
+COMMAND_SCHEMA = cv.Schema(
+    {
+        # The name identifies the enrolled template in flash, renaming a command drops its template
+        cv.Required(CONF_NAME): cv.string_strict,
+        cv.Required(CONF_ON_DETECTED): automation.validate_automation(
+            {
+                cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(automation.Trigger.template()),
+            },
+            single=True,
+        ),
+    }
+)
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(FetapCommands),
+        cv.Required(CONF_MICROPHONE): cv.use_id(FetapMicrophone),
+        # Maximum distance between an utterance and a template, lower values reject more
+        cv.Optional(CONF_THRESHOLD, default=250): cv.int_range(min=1, max=2000),
+        cv.Required(CONF_COMMANDS): cv.All(
+            cv.ensure_list(COMMAND_SCHEMA), cv.Length(min=1, max=20), validate_unique_names
+        ),
+        cv.Optional(CONF_ON_UNRECOGNIZED): automation.validate_automation(single=True),
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    mic = await cg.get_variable(config[CONF_MICROPHONE])
+    cg.add(var.set_microphone(mic))
+    cg.add(var.set_threshold(config[CONF_THRESHOLD]))
+
+    for command in config[CONF_COMMANDS]:
+        conf = command[CONF_ON_DETECTED]
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID])
+        cg.add(var.add_command(command[CONF_NAME], trigger))
+        await automation.build_automation(trigger, [], conf)
+
+    if CONF_ON_UNRECOGNIZED in config:
+        # The audio of unrecognized utterances is buffered and replayed to whoever starts the microphone next
+        cg.add(var.set_handoff(True))
+        await automation.build_automation(var.get_unrecognized_trigger(), [], config[CONF_ON_UNRECOGNIZED])
+
+
+FETAP_COMMANDS_ACTION_SCHEMA = cv.Schema({cv.GenerateID(): cv.use_id(FetapCommands)})
+
+
+@automation.register_action("fetap_commands.start", FetapCommandsStartAction, FETAP_COMMANDS_ACTION_SCHEMA)
+@automation.register_action("fetap_commands.stop", FetapCommandsStopAction, FETAP_COMMANDS_ACTION_SCHEMA)
+async def fetap_commands_action_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+
+@automation.register_action(
+    "fetap_commands.enroll",
+    FetapCommandsEnrollAction,
+    FETAP_COMMANDS_ACTION_SCHEMA.extend(
+        {
+            cv.Required(CONF_COMMAND): cv.templatable(cv.string_strict),
+        }
+    ),
+)
+async def fetap_commands_enroll_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    command = await cg.templatable(config[CONF_COMMAND], args, cg.std_string)
+    cg.add(var.set_command(command))
+    return var
+
+
+@automation.register_condition(
+    "fetap_commands.is_listening", FetapCommandsIsListeningCondition, FETAP_COMMANDS_ACTION_SCHEMA
+)
+async def fetap_commands_is_listening_to_code(config, condition_id, template_arg, args):
+    var = cg.new_Pvariable(condition_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include "esphome/core/automation.h"
+
+#include "fetap_commands.h"
+
+namespace esphome {
+namespace fetap {
+
+/*
+    Starts listening for commands
+*/
+template<typename... Ts> class FetapCommandsStartAction : public Action<Ts...>, public Parented<FetapCommands> {
+public:
+    void play(Ts... x) override { this->parent_->start(); }
+};
+
+/*
+    Stops listening for commands
+*/
+template<typename... Ts> class FetapCommandsStopAction : public Action<Ts...>, public Parented<FetapCommands> {
+public:
+    void play(Ts... x) override { this->parent_->stop(); }
+};
+
+/*
+    Records the next utterance as the template of a command
+*/
+template<typename... Ts> class FetapCommandsEnrollAction : public Action<Ts...>, public Parented<FetapCommands> {
+public:
+    TEMPLATABLE_VALUE(std::string, command)
+
+    void play(Ts... x) override { this->parent_->enroll(this->command_.value(x...)); }
+};
+
+/*
+    True while the component listens for commands
+*/
+template<typename... Ts> class FetapCommandsIsListeningCondition : public Condition<Ts...>, public Parented<FetapCommands> {
+public:
+    bool check(Ts... x) override { return this->parent_->is_listening(); }
+};
+
+}
+}
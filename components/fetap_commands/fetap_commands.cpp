@@ -0,0 +1,353 @@
+#include "fetap_commands.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <new>
+
+#include <esp_timer.h>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+
+namespace fetap {
+
+static const char *const TAG = "fetap.commands";
+static const size_t TASK_STACK_SIZE = 4096;
+static const ssize_t TASK_PRIORITY = 2;
+
+void FetapCommands::setup(void) {
+    for (Command &command : commands_) {
+        command.preference = global_preferences->make_preference<Template>(fnv1_hash("fetap_commands_" + command.name));
+        if (!command.preference.load(&command.templ) || command.templ.n_frames > kMaxTemplateFrames) {
+            command.templ.n_frames = 0;
+        }
+    }
+
+    mfcc_.init();
+    frames_.reserve(kMaxUtteranceFrames);
+    features_.reserve(kMaxUtteranceFrames * FetapMfcc::kNumCoefficients);
+
+    if (handoff_) {
+        audio_.reset(new (std::nothrow) int16_t[kHandoffSamples]);
+        if (!audio_) {
+            // Recognition still works, unrecognized utterances just have to be repeated
+            ESP_LOGW(TAG, "Error allocating handoff buffer, the utterance audio is not handed over");
+            status_set_warning();
+            handoff_ = false;
+        }
+    }
+
+    result_queue_ = xQueueCreate(kResultQueueLength, sizeof(Result));
+    if (result_queue_ == nullptr) {
+        ESP_LOGE(TAG, "Error allocating result queue");
+        mark_failed();
+        status_set_error();
+        return;
+    }
+
+    // Lower priority than the dial sensor, the feature extraction only needs to keep up on average
+    xTaskCreate(FetapCommands::recognition_task, "fetapcmd_task", TASK_STACK_SIZE, (void *) this, TASK_PRIORITY,
+                &task_handle_);
+
+    ESP_LOGI(TAG, "Fetap Commands initialized successfully.");
+}
+
+void FetapCommands::dump_config(void) {
+    ESP_LOGCONFIG(TAG, "Fetap Commands:");
+    ESP_LOGCONFIG(TAG, "  Threshold: %" PRIu32, threshold_);
+    for (const Command &command : commands_) {
+        if (command.templ.n_frames > 0) {
+            ESP_LOGCONFIG(TAG, "  Command '%s': enrolled (%u frames)", command.name.c_str(), command.templ.n_frames);
+        } else {
+            ESP_LOGCONFIG(TAG, "  Command '%s': not enrolled", command.name.c_str());
+        }
+    }
+}
+
+void FetapCommands::add_command(const std::string &name, Trigger<> *trigger) {
+    Command command{};
+    command.name = name;
+    command.trigger = trigger;
+    commands_.push_back(command);
+}
+
+void FetapCommands::start(void) {
+    if (is_failed()) {
+        return;
+    }
+
+    // The active subscription keeps the microphone capturing without starting it through the
+    // microphone interface, so a voice assistant using the same microphone is not cut off by stop()
+    listening_.store(true, std::memory_order_relaxed);
+    subscriber_.set_active(true);
+}
+
+void FetapCommands::stop(void) {
+    listening_.store(false, std::memory_order_relaxed);
+    enroll_index_.store(kNoEnrollment, std::memory_order_relaxed);
+    subscriber_.set_active(false);
+    subscriber_.flush();
+}
+
+void FetapCommands::enroll(const std::string &command) {
+    for (size_t i = 0; i < commands_.size(); i++) {
+        if (commands_[i].name == command) {
+            ESP_LOGI(TAG, "Say '%s' to enroll the command", command.c_str());
+            enroll_index_.store(static_cast<int8_t>(i), std::memory_order_relaxed);
+            start();
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "Unknown command '%s'", command.c_str());
+}
+
+void FetapCommands::loop(void) {
+    if (result_queue_ == nullptr) {
+        return;
+    }
+
+    if (handoff_replaying_ && !microphone_->is_replaying()) {
+        // The microphone handed the audio to the data callbacks or discarded it, the task may reuse the buffer
+        handoff_replaying_ = false;
+        handoff_locked_.store(false, std::memory_order_release);
+    }
+
+    Result result;
+    while (xQueueReceive(result_queue_, &result, 0) == pdTRUE) {
+        const float utterance_us = static_cast<float>(result.n_frames * FetapMfcc::kFrameShift) * 1e6f / FetapMfcc::kSampleRate;
+        real_time_factor_ = utterance_us > 0.0f ? static_cast<float>(result.busy_us) / utterance_us : 0.0f;
+
+        switch (result.type) {
+            case Result::Type::RECOGNIZED:
+                ESP_LOGI(TAG, "Recognized '%s' (distance %" PRIu32 ", next %" PRIu32 ") %" PRIu32 " ms after the utterance, real-time factor %.3f",
+                         commands_[result.command].name.c_str(), result.distance, result.second_distance,
+                         result.match_us / 1000, real_time_factor_);
+                commands_[result.command].trigger->trigger();
+                break;
+            case Result::Type::UNRECOGNIZED:
+                ESP_LOGI(TAG, "No command recognized (distance %" PRIu32 ", next %" PRIu32 "), real-time factor %.3f",
+                         result.distance, result.second_distance, real_time_factor_);
+                if (result.handoff_samples > 0) {
+                    // Replayed as soon as the trigger, e.g. voice_assistant.start, starts the microphone
+                    microphone_->replay(audio_.get(), result.handoff_samples);
+                    handoff_replaying_ = true;
+                }
+                unrecognized_trigger_->trigger();
+                break;
+            case Result::Type::ENROLLED:
+                // Flash writes stay in the main loop
+                if (!commands_[result.command].preference.save(&commands_[result.command].templ)) {
+                    ESP_LOGW(TAG, "Error saving template of '%s'", commands_[result.command].name.c_str());
+                    status_set_warning();
+                    break;
+                }
+                ESP_LOGI(TAG, "Enrolled '%s' (%" PRIu32 " frames)", commands_[result.command].name.c_str(), result.n_frames);
+                break;
+            case Result::Type::ENROLL_FAILED:
+                ESP_LOGW(TAG, "Enrollment of '%s' failed, the utterance was longer than %u ms",
+                         commands_[result.command].name.c_str(), static_cast<unsigned>(kMaxTemplateFrames * 10));
+                break;
+        }
+    }
+}
+
+void FetapCommands::recognition_task(void *params) {
+    FetapCommands *instance = static_cast<FetapCommands *>(params);
+
+    while (1) {
+        instance->task_loop_();
+    }
+}
+
+void FetapCommands::task_loop_(void) {
+    FetapAudioBlock *block = subscriber_.receive(portMAX_DELAY);
+    if (block == nullptr) {
+        return;
+    }
+
+    const bool listening = listening_.load(std::memory_order_relaxed);
+    if (listening && !was_listening_) {
+        // Start from scratch, the audio before the last stop is not related
+        mfcc_.reset();
+        detector_.reset();
+        frames_.clear();
+        n_preroll_ = 0;
+        overflow_ = false;
+        busy_us_ = 0;
+        n_frames_seen_ = 0;
+        n_samples_seen_ = 0;
+        audio_valid_from_ = 0;
+        utterance_start_ = 0;
+        was_locked_ = handoff_locked_.load(std::memory_order_acquire);
+    }
+    was_listening_ = listening;
+
+    if (listening) {
+        const int64_t start_us = esp_timer_get_time();
+        store_audio_(block->data(), block->size());
+        mfcc_.process(block->data(), block->size(), [this](const FetapMfcc::Frame &frame) { process_frame_(frame); });
+        busy_us_ += esp_timer_get_time() - start_us;
+    }
+    block->release();
+}
+
+void FetapCommands::store_audio_(const int16_t *samples, size_t n_samples) {
+    const uint32_t position = n_samples_seen_;
+    n_samples_seen_ += n_samples;
+    if (!audio_) {
+        return;
+    }
+
+    // The buffer holds the last handoff until the microphone replayed it
+    if (handoff_locked_.load(std::memory_order_acquire)) {
+        was_locked_ = true;
+        return;
+    }
+    if (was_locked_) {
+        was_locked_ = false;
+        audio_valid_from_ = position;
+    }
+
+    // Keep the start of an utterance that is longer than the buffer, it matters most to the assistant
+    size_t n_store = n_samples;
+    if (detector_.in_utterance()) {
+        const uint32_t end = utterance_start_ + kHandoffSamples;
+        n_store = end > position ? std::min<size_t>(n_samples, end - position) : 0;
+    }
+
+    for (size_t i = 0; i < n_store; i++) {
+        audio_[(position + i) & (kHandoffSamples - 1)] = samples[i];
+    }
+}
+
+uint32_t FetapCommands::prepare_handoff_(void) {
+    if (!audio_ || was_locked_ || handoff_locked_.load(std::memory_order_acquire)) {
+        return 0;
+    }
+
+    const uint32_t start = std::max(utterance_start_, audio_valid_from_);
+    const uint32_t n_samples = std::min<uint32_t>(n_samples_seen_ - start, kHandoffSamples);
+    if (n_samples == 0) {
+        return 0;
+    }
+
+    std::rotate(audio_.get(), audio_.get() + (start & (kHandoffSamples - 1)), audio_.get() + kHandoffSamples);
+    handoff_locked_.store(true, std::memory_order_release);
+    return n_samples;
+}
+
+void FetapCommands::process_frame_(const FetapMfcc::Frame &frame) {
+    const uint32_t frame_index = n_frames_seen_++;
+    const bool in_utterance = detector_.in_utterance();
+    const FetapUtteranceDetector::Event event = detector_.process(frame.log_energy);
+
+    if (!in_utterance) {
+        preroll_[n_preroll_++ % FetapUtteranceDetector::kStartFrames] = frame;
+        if (event != FetapUtteranceDetector::Event::STARTED) {
+            // Only the processing time of the utterance counts for the real-time factor
+            busy_us_ = 0;
+            return;
+        }
+
+        // The frames that triggered the start belong to the utterance. Frame j covers the samples
+        // from j * kFrameShift on, the first audio of the utterance is the first sample of the oldest one.
+        const uint32_t n_frames = frame_index + 1;
+        const uint32_t first_frame = n_frames > FetapUtteranceDetector::kStartFrames ? n_frames - FetapUtteranceDetector::kStartFrames : 0;
+        utterance_start_ = std::max(audio_valid_from_, first_frame * static_cast<uint32_t>(FetapMfcc::kFrameShift));
+
+        frames_.clear();
+        overflow_ = false;
+        for (size_t i = 0; i < FetapUtteranceDetector::kStartFrames; i++) {
+            frames_.push_back(preroll_[(n_preroll_ + i) % FetapUtteranceDetector::kStartFrames]);
+        }
+        return;
+    }
+
+    if (frames_.size() < kMaxUtteranceFrames) {
+        frames_.push_back(frame);
+    } else {
+        overflow_ = true;
+    }
+
+    if (event == FetapUtteranceDetector::Event::ENDED) {
+        n_preroll_ = 0;
+        // Without the trailing silence of the hangover
+        const size_t n_frames = overflow_ ? 0 : frames_.size() - FetapUtteranceDetector::kHangoverFrames;
+        finish_utterance_(n_frames, esp_timer_get_time());
+    }
+}
+
+void FetapCommands::finish_utterance_(size_t n_frames, int64_t end_us) {
+    const int8_t enroll_index = enroll_index_.exchange(kNoEnrollment, std::memory_order_relaxed);
+
+    Result result{};
+    result.command = enroll_index;
+    result.distance = UINT32_MAX;
+    result.second_distance = UINT32_MAX;
+    result.n_frames = frames_.size();
+
+    if (n_frames > 0) {
+        features_.resize(n_frames * FetapMfcc::kNumCoefficients);
+        fetap_normalize_features(frames_.data(), n_frames, features_.data());
+    }
+
+    if (enroll_index != kNoEnrollment) {
+        Template &templ = commands_[enroll_index].templ;
+        if (n_frames == 0 || n_frames > kMaxTemplateFrames) {
+            result.type = Result::Type::ENROLL_FAILED;
+        } else {
+            // The main loop only reads the template after it received the result
+            std::copy(features_.begin(), features_.end(), templ.features);
+            templ.n_frames = static_cast<uint8_t>(n_frames);
+            result.type = Result::Type::ENROLLED;
+        }
+    } else {
+        // An utterance far longer than any template is most likely a request for the voice assistant,
+        // the length check of the DTW rejects it against every template.
+        result.command = -1;
+        for (size_t i = 0; i < commands_.size() && n_frames > 0; i++) {
+            const Template &templ = commands_[i].templ;
+            if (templ.n_frames == 0) {
+                continue;
+            }
+            const uint32_t distance = fetap_dtw_distance(features_.data(), n_frames, templ.features, templ.n_frames, dtw_scratch_);
+            if (distance < result.distance) {
+                result.second_distance = result.distance;
+                result.distance = distance;
+                result.command = static_cast<int8_t>(i);
+            } else if (distance < result.second_distance) {
+                result.second_distance = distance;
+            }
+        }
+
+        // Accept only clear matches, a low confidence result falls back to the unrecognized trigger
+        const bool confident = result.distance <= threshold_ &&
+                               (result.second_distance == UINT32_MAX ||
+                                static_cast<uint64_t>(result.distance) * 100 <= static_cast<uint64_t>(result.second_distance) * (100 - kMinMarginPercent));
+        result.type = confident ? Result::Type::RECOGNIZED : Result::Type::UNRECOGNIZED;
+        if (result.type == Result::Type::UNRECOGNIZED && handoff_) {
+            result.handoff_samples = prepare_handoff_();
+        }
+    }
+
+    const int64_t now_us = esp_timer_get_time();
+    busy_us_ += now_us - end_us;
+    result.match_us = static_cast<uint32_t>(now_us - end_us);
+    result.busy_us = static_cast<uint32_t>(busy_us_);
+    busy_us_ = 0;
+    frames_.clear();
+
+    if (xQueueSend(result_queue_, &result, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Result queue is full, dropping result");
+        if (result.handoff_samples > 0) {
+            handoff_locked_.store(false, std::memory_order_release);
+        }
+    }
+}
+
+}
+
+}
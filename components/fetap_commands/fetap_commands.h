@@ -0,0 +1,247 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "esphome/core/automation.h"
+#include "esphome/core/component.h"
+#include "esphome/core/preferences.h"
+
+#include "../fetap_microphone/fetap_microphone.h"
+#include "fetap_features.h"
+
+namespace esphome {
+namespace fetap {
+
+/*
+    The fetap commands component recognizes a small vocabulary of enrolled spoken commands locally on the
+    device. It subscribes to the audio blocks of the fetap microphone, extracts fixed-point MFCC features
+    in its own task and matches each utterance against one enrolled template per command with dynamic
+    time warping. Commands fire their trigger from the main loop right after the end of the utterance,
+    utterances that do not match any command confidently fire the unrecognized trigger instead, which is
+    meant to hand over to the voice assistant. With the handoff enabled, the audio of such an utterance is
+    replayed to the data callbacks of the microphone when it is started next, so the voice assistant gets
+    the request without the user repeating it.
+*/
+class FetapCommands : public Component {
+public:
+
+    /* --------------------------- Functions inherited from component interface --------------------------- */
+
+    /*
+        Called initially to load the enrolled templates and start the task
+    */
+    void setup(void) override;
+
+    /*
+        Called repeatedly, fires the triggers for the results of the recognition task
+    */
+    void loop(void) override;
+
+    /*
+        Logs the commands and the state of their templates
+    */
+    void dump_config(void) override;
+
+    /* --------------------------- Functions triggered from automations --------------------------- */
+
+    /*
+        Starts listening for commands. The active block subscription keeps the microphone capturing.
+    */
+    void start(void);
+
+    /*
+        Stops listening for commands. The microphone keeps running if it was started by another component.
+    */
+    void stop(void);
+
+    /*
+        Records the next utterance as the template of the given command, replacing the previous template.
+        Starts listening if necessary.
+
+        \param  command     Name of the command
+    */
+    void enroll(const std::string &command);
+
+    /*
+        \returns    True while listening for commands
+    */
+    bool is_listening(void) const { return listening_.load(std::memory_order_relaxed); }
+
+    /*
+        \returns    Processing time divided by audio duration of the last utterance
+    */
+    float get_real_time_factor(void) const { return real_time_factor_; }
+
+    /* --------------------------- Functions triggered from code generation --------------------------- */
+
+    /*
+        Sets the microphone the audio blocks are taken from and subscribes to it. This happens before
+        the setup of the microphone, which sizes its block pool for all subscribers.
+
+        \param  microphone  The fetap microphone
+    */
+    void set_microphone(FetapMicrophone *microphone) {
+        microphone_ = microphone;
+        microphone_->add_block_subscriber(&subscriber_);
+    }
+
+    /*
+        Sets the maximum DTW distance at which an utterance is accepted as a command
+
+        \param  threshold   The maximum distance
+    */
+    void set_threshold(int threshold) { threshold_ = static_cast<uint32_t>(threshold); }
+
+    /*
+        Enables buffering the audio of utterances so unrecognized ones can be handed over to the voice
+        assistant through FetapMicrophone::replay()
+
+        \param  handoff     True to enable the handoff
+    */
+    void set_handoff(bool handoff) { handoff_ = handoff; }
+
+    /*
+        Adds a command to the vocabulary
+
+        \param  name        Name of the command, also identifies the stored template
+        \param  trigger     Trigger that fires when the command was recognized
+    */
+    void add_command(const std::string &name, Trigger<> *trigger);
+
+    /*
+        \returns    Trigger that fires when an utterance did not match any command confidently
+    */
+    Trigger<> *get_unrecognized_trigger(void) const { return unrecognized_trigger_; }
+
+private:
+    static constexpr size_t kMaxTemplateFrames{100}; /*!< Maximum length of an enrolled template (1 s) */
+    static constexpr size_t kMaxUtteranceFrames{2 * kMaxTemplateFrames}; /*!< Longer utterances can not match any template */
+    static constexpr size_t kTemplateSize{kMaxTemplateFrames * FetapMfcc::kNumCoefficients}; /*!< Features of a template */
+    static constexpr uint32_t kMinMarginPercent{20}; /*!< Required distance margin of the best over the second best command */
+    static constexpr uint32_t kDefaultThreshold{250}; /*!< Default maximum DTW distance of a match */
+    static constexpr uint8_t kBlockQueueDepth{8}; /*!< Audio blocks buffered for the recognition task */
+    static constexpr uint8_t kResultQueueLength{4}; /*!< Results buffered for the main loop */
+    static constexpr int8_t kNoEnrollment{-1}; /*!< Value of enroll_index_ while not enrolling */
+    static constexpr size_t kHandoffSamples{32768}; /*!< Audio buffered for the handoff (2 s), a power of two */
+
+    /*
+        Enrolled template of a command as stored in the preferences
+    */
+    struct Template {
+        uint8_t n_frames; /*!< Number of frames, 0 if nothing has been enrolled */
+        int8_t features[kTemplateSize]; /*!< Normalized features of the frames */
+    };
+
+    /*
+        A command of the vocabulary
+    */
+    struct Command {
+        std::string name; /*!< Name of the command */
+        Trigger<> *trigger; /*!< Fires when the command was recognized */
+        ESPPreferenceObject preference; /*!< Storage of the template */
+        Template templ; /*!< Enrolled template */
+    };
+
+    /*
+        Result of an utterance passed from the recognition task to the main loop
+    */
+    struct Result {
+        enum class Type : uint8_t {
+            RECOGNIZED, /*!< the utterance matched a command */
+            UNRECOGNIZED, /*!< the utterance did not match any command */
+            ENROLLED, /*!< the utterance was stored as template of a command */
+            ENROLL_FAILED, /*!< the utterance was too long for a template */
+        } type;
+        int8_t command; /*!< Index of the matched or enrolled command, -1 if none */
+        uint32_t distance; /*!< DTW distance of the best command */
+        uint32_t second_distance; /*!< DTW distance of the second best command */
+        uint32_t n_frames; /*!< Length of the utterance in frames */
+        uint32_t match_us; /*!< Time from the detected end of the utterance to the result */
+        uint32_t busy_us; /*!< Processing time spent on the utterance */
+        uint32_t handoff_samples; /*!< Number of samples of the utterance in audio_ for the handoff, 0 if none */
+    };
+
+    /*
+        Function that is registered as a task to run asynchronously from main loop
+    */
+    static void recognition_task(void *params);
+
+    /*
+        Repeatedly called by the recognition task. Extracts the features of the next audio block.
+    */
+    void task_loop_(void);
+
+    /*
+        Feeds a frame to the utterance detector and collects the frames of the utterance
+
+        \param  frame   Features of the frame
+    */
+    void process_frame_(const FetapMfcc::Frame &frame);
+
+    /*
+        Normalizes the collected utterance and either stores it as template or matches it against
+        the templates. Runs in the recognition task.
+
+        \param  n_frames    Number of frames of the utterance without the trailing silence
+        \param  end_us      Time at which the end of the utterance was detected
+    */
+    void finish_utterance_(size_t n_frames, int64_t end_us);
+
+    /*
+        Appends the samples of a block to the handoff ring buffer. Runs in the recognition task.
+
+        \param  samples     The samples
+        \param  n_samples   Number of samples
+    */
+    void store_audio_(const int16_t *samples, size_t n_samples);
+
+    /*
+        Moves the audio of the current utterance to the start of the handoff buffer and locks the buffer
+        until the microphone replayed it. Runs in the recognition task.
+
+        \returns    Number of samples of the utterance, 0 if the buffer is still locked by the last handoff
+    */
+    uint32_t prepare_handoff_(void);
+
+    FetapMicrophone *microphone_{nullptr}; /*!< Source of the audio blocks */
+    FetapAudioBlockSubscriber subscriber_{kBlockQueueDepth, FetapAudioBlockSubscriber::DropPolicy::DROP_OLDEST}; /*!< Audio blocks for the recognition task */
+    std::vector<Command> commands_; /*!< The vocabulary */
+    Trigger<> *unrecognized_trigger_{new Trigger<>()}; /*!< Fires when an utterance did not match */
+    uint32_t threshold_{kDefaultThreshold}; /*!< Maximum DTW distance of a match */
+    float real_time_factor_{0.0f}; /*!< Real-time factor of the last utterance */
+    bool handoff_{false}; /*!< True if unrecognized utterances are handed over to the voice assistant */
+    bool handoff_replaying_{false}; /*!< True while the microphone replays the handoff audio, main loop only */
+    std::unique_ptr<int16_t[]> audio_; /*!< Ring buffer with the latest audio, holds the handoff audio while locked */
+    std::atomic<bool> handoff_locked_{false}; /*!< True from prepare_handoff_() until the microphone replayed audio_ */
+    std::atomic<bool> listening_{false}; /*!< True while listening for commands */
+    std::atomic<int8_t> enroll_index_{kNoEnrollment}; /*!< Command that the next utterance is enrolled for */
+    QueueHandle_t result_queue_{nullptr}; /*!< Results passed from the recognition task to the main loop */
+    TaskHandle_t task_handle_{nullptr}; /*!< Reference to the recognition task */
+
+    // State of the recognition task
+    FetapMfcc mfcc_; /*!< Feature extraction */
+    FetapUtteranceDetector detector_; /*!< Start and end detection of utterances */
+    std::vector<FetapMfcc::Frame> frames_; /*!< Frames of the current utterance */
+    FetapMfcc::Frame preroll_[FetapUtteranceDetector::kStartFrames]; /*!< Last frames before an utterance started */
+    size_t n_preroll_{0}; /*!< Number of frames seen while no utterance was ongoing */
+    bool overflow_{false}; /*!< True if the current utterance exceeded kMaxUtteranceFrames */
+    bool was_listening_{false}; /*!< Listening state of the previous block */
+    std::vector<int8_t> features_; /*!< Normalized features of the last utterance */
+    std::vector<uint32_t> dtw_scratch_; /*!< Scratch buffer of the DTW */
+    int64_t busy_us_{0}; /*!< Processing time spent on the current utterance */
+    uint32_t n_frames_seen_{0}; /*!< Number of frames since listening started */
+    uint32_t n_samples_seen_{0}; /*!< Number of samples since listening started, positions in audio_ */
+    uint32_t audio_valid_from_{0}; /*!< First sample position that audio_ still holds after a handoff */
+    uint32_t utterance_start_{0}; /*!< Sample position of the first frame of the current utterance */
+    bool was_locked_{false}; /*!< Lock state of audio_ seen with the previous block */
+};
+
+}
+}
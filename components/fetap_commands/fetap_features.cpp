@@ -0,0 +1,285 @@
+#include "fetap_features.h"
+
+#include <cmath>
+
+namespace esphome {
+
+namespace fetap {
+
+static int16_t to_q15(double value) {
+    const double scaled = std::round(value * 32768.0);
+    return static_cast<int16_t>(scaled > 32767.0 ? 32767.0 : (scaled < -32768.0 ? -32768.0 : scaled));
+}
+
+static double hz_to_mel(double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+
+static double mel_to_hz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+void FetapMfcc::init(void) {
+    const double pi = std::acos(-1.0);
+
+    for (size_t i = 0; i < kFrameLength; i++) {
+        window_[i] = to_q15(0.54 - 0.46 * std::cos(2.0 * pi * i / (kFrameLength - 1)));
+    }
+
+    for (size_t i = 0; i < kFftSize / 2; i++) {
+        cos_[i] = to_q15(std::cos(2.0 * pi * i / kFftSize));
+        sin_[i] = to_q15(-std::sin(2.0 * pi * i / kFftSize));
+    }
+
+    size_t n_bits{0};
+    while ((static_cast<size_t>(1) << n_bits) < kFftSize) {
+        n_bits++;
+    }
+    for (size_t i = 0; i < kFftSize; i++) {
+        size_t reversed{0};
+        for (size_t bit = 0; bit < n_bits; bit++) {
+            reversed |= ((i >> bit) & 1) << (n_bits - 1 - bit);
+        }
+        bit_reverse_[i] = static_cast<uint16_t>(reversed);
+    }
+
+    // Triangular filters equally spaced on the mel scale between 100 Hz and 7000 Hz
+    const double mel_low = hz_to_mel(100.0);
+    const double mel_high = hz_to_mel(7000.0);
+    double edges[kNumFilters + 2];
+    for (size_t i = 0; i < kNumFilters + 2; i++) {
+        edges[i] = mel_to_hz(mel_low + (mel_high - mel_low) * i / (kNumFilters + 1)) * kFftSize / kSampleRate;
+    }
+    filter_weights_.clear();
+    for (size_t m = 0; m < kNumFilters; m++) {
+        const size_t start = static_cast<size_t>(std::ceil(edges[m]));
+        const size_t end = static_cast<size_t>(std::floor(edges[m + 2]));
+        filter_start_[m] = static_cast<uint16_t>(start);
+        filter_length_[m] = static_cast<uint16_t>(end >= start ? end - start + 1 : 0);
+        for (size_t bin = start; bin <= end; bin++) {
+            const double weight = bin <= edges[m + 1] ? (bin - edges[m]) / (edges[m + 1] - edges[m])
+                                                      : (edges[m + 2] - bin) / (edges[m + 2] - edges[m + 1]);
+            filter_weights_.push_back(static_cast<uint16_t>(std::round(std::fmax(0.0, weight) * 32767.0)));
+        }
+    }
+
+    for (size_t k = 0; k < kNumCoefficients; k++) {
+        for (size_t m = 0; m < kNumFilters; m++) {
+            dct_[k][m] = to_q15(std::cos(pi * (k + 1) * (m + 0.5) / kNumFilters) * 0.999);
+        }
+    }
+
+    reset();
+}
+
+void FetapMfcc::reset(void) {
+    buffered_ = 0;
+    previous_sample_ = 0;
+}
+
+int32_t FetapMfcc::log2_q8(uint64_t value) {
+    if (value == 0) {
+        return 0;
+    }
+    int32_t msb{63};
+    while ((value >> msb) == 0) {
+        msb--;
+    }
+    // Linear interpolation of the mantissa, the error is below 0.09
+    const uint32_t mantissa = msb >= 8 ? static_cast<uint32_t>(value >> (msb - 8)) & 0xFF
+                                       : static_cast<uint32_t>(value << (8 - msb)) & 0xFF;
+    return (msb << 8) + static_cast<int32_t>(mantissa);
+}
+
+void FetapMfcc::fft_(void) {
+    for (size_t i = 0; i < kFftSize; i++) {
+        const size_t j = bit_reverse_[i];
+        if (i < j) {
+            const int32_t re = re_[i];
+            const int32_t im = im_[i];
+            re_[i] = re_[j];
+            im_[i] = im_[j];
+            re_[j] = re;
+            im_[j] = im;
+        }
+    }
+
+    // The input is at most 2^15, the output at most 2^24, so no scaling between the stages is needed
+    for (size_t half = 1; half < kFftSize; half <<= 1) {
+        const size_t step = kFftSize / (half << 1);
+        for (size_t start = 0; start < kFftSize; start += half << 1) {
+            for (size_t k = 0; k < half; k++) {
+                const int64_t w_re = cos_[k * step];
+                const int64_t w_im = sin_[k * step];
+                const size_t a = start + k;
+                const size_t b = a + half;
+                const int32_t t_re = static_cast<int32_t>((w_re * re_[b] - w_im * im_[b]) >> 15);
+                const int32_t t_im = static_cast<int32_t>((w_re * im_[b] + w_im * re_[b]) >> 15);
+                re_[b] = re_[a] - t_re;
+                im_[b] = im_[a] - t_im;
+                re_[a] += t_re;
+                im_[a] += t_im;
+            }
+        }
+    }
+}
+
+const FetapMfcc::Frame &FetapMfcc::compute_frame_(void) {
+    uint64_t energy{0};
+    for (size_t i = 0; i < kFrameLength; i++) {
+        int32_t sample = buffer_[i];
+        sample = sample > INT16_MAX ? INT16_MAX : (sample < INT16_MIN ? INT16_MIN : sample);
+        energy += static_cast<uint64_t>(static_cast<int64_t>(sample) * sample);
+        re_[i] = (sample * window_[i]) >> 15;
+        im_[i] = 0;
+    }
+    for (size_t i = kFrameLength; i < kFftSize; i++) {
+        re_[i] = 0;
+        im_[i] = 0;
+    }
+    frame_.log_energy = log2_q8(energy);
+
+    fft_();
+
+    // Power spectrum, scaled so that the weighted filter sums cannot overflow
+    for (size_t bin = 0; bin < kNumBins; bin++) {
+        const int64_t re = re_[bin];
+        const int64_t im = im_[bin];
+        power_[bin] = static_cast<uint64_t>(re * re + im * im) >> 8;
+    }
+
+    int32_t log_mel[kNumFilters];
+    const uint16_t *weight = filter_weights_.data();
+    for (size_t m = 0; m < kNumFilters; m++) {
+        uint64_t mel_energy{1};
+        for (size_t i = 0; i < filter_length_[m]; i++) {
+            mel_energy += power_[filter_start_[m] + i] * *weight++;
+        }
+        log_mel[m] = log2_q8(mel_energy);
+    }
+
+    for (size_t k = 0; k < kNumCoefficients; k++) {
+        int64_t acc{0};
+        for (size_t m = 0; m < kNumFilters; m++) {
+            acc += static_cast<int64_t>(dct_[k][m]) * log_mel[m];
+        }
+        frame_.cepstrum[k] = static_cast<int32_t>(acc >> 15);
+    }
+
+    return frame_;
+}
+
+FetapUtteranceDetector::Event FetapUtteranceDetector::process(int32_t log_energy) {
+    // The floor drops immediately to quieter frames and rises slowly otherwise
+    if (log_energy < noise_floor_) {
+        noise_floor_ = log_energy;
+    } else if (!in_utterance_) {
+        noise_floor_ += kFloorRiseQ8;
+    }
+
+    if (!in_utterance_) {
+        loud_frames_ = log_energy > noise_floor_ + kStartThresholdQ8 ? loud_frames_ + 1 : 0;
+        if (loud_frames_ >= kStartFrames) {
+            in_utterance_ = true;
+            quiet_frames_ = 0;
+            return Event::STARTED;
+        }
+        return Event::NONE;
+    }
+
+    quiet_frames_ = log_energy < noise_floor_ + kEndThresholdQ8 ? quiet_frames_ + 1 : 0;
+    if (quiet_frames_ >= kHangoverFrames) {
+        in_utterance_ = false;
+        loud_frames_ = 0;
+        return Event::ENDED;
+    }
+    return Event::NONE;
+}
+
+void FetapUtteranceDetector::reset(void) {
+    in_utterance_ = false;
+    loud_frames_ = 0;
+    quiet_frames_ = 0;
+}
+
+void fetap_normalize_features(const FetapMfcc::Frame *frames, size_t n_frames, int8_t *features) {
+    if (n_frames == 0) {
+        return;
+    }
+
+    // Cepstral mean normalization removes the static coloring of microphone and handset
+    int32_t mean[FetapMfcc::kNumCoefficients];
+    for (size_t k = 0; k < FetapMfcc::kNumCoefficients; k++) {
+        int64_t sum{0};
+        for (size_t i = 0; i < n_frames; i++) {
+            sum += frames[i].cepstrum[k];
+        }
+        mean[k] = static_cast<int32_t>(sum / static_cast<int64_t>(n_frames));
+    }
+
+    // One feature unit corresponds to 1/16 log2 unit
+    for (size_t i = 0; i < n_frames; i++) {
+        for (size_t k = 0; k < FetapMfcc::kNumCoefficients; k++) {
+            const int32_t value = (frames[i].cepstrum[k] - mean[k]) >> 4;
+            features[i * FetapMfcc::kNumCoefficients + k] = static_cast<int8_t>(value > INT8_MAX ? INT8_MAX : (value < INT8_MIN ? INT8_MIN : value));
+        }
+    }
+}
+
+uint32_t fetap_dtw_distance(const int8_t *a, size_t n_a, const int8_t *b, size_t n_b, std::vector<uint32_t> &scratch) {
+    constexpr size_t kDim{FetapMfcc::kNumCoefficients};
+
+    if (n_a == 0 || n_b == 0 || n_a > 2 * n_b || n_b > 2 * n_a) {
+        return UINT32_MAX;
+    }
+
+    // Sakoe-Chiba band around the diagonal, wide enough to reach the end point
+    const size_t longer = n_a > n_b ? n_a : n_b;
+    const size_t length_difference = n_a > n_b ? n_a - n_b : n_b - n_a;
+    const size_t band = (longer / 4 > length_difference ? longer / 4 : length_difference) + 1;
+
+    scratch.assign(2 * (n_b + 1), UINT32_MAX);
+    uint32_t *previous = scratch.data();
+    uint32_t *current = scratch.data() + n_b + 1;
+    previous[0] = 0;
+
+    for (size_t i = 1; i <= n_a; i++) {
+        // Position of row i on the diagonal in columns of b
+        const size_t center = i * n_b / n_a;
+        const size_t j_start = center > band ? center - band : 1;
+        const size_t j_end = center + band < n_b ? center + band : n_b;
+
+        for (size_t j = 0; j <= n_b; j++) {
+            current[j] = UINT32_MAX;
+        }
+        for (size_t j = j_start < 1 ? 1 : j_start; j <= j_end; j++) {
+            const int8_t *frame_a = a + (i - 1) * kDim;
+            const int8_t *frame_b = b + (j - 1) * kDim;
+            uint32_t cost{0};
+            for (size_t k = 0; k < kDim; k++) {
+                const int32_t difference = static_cast<int32_t>(frame_a[k]) - frame_b[k];
+                cost += static_cast<uint32_t>(difference < 0 ? -difference : difference);
+            }
+
+            uint32_t best = previous[j - 1];
+            if (previous[j] < best) {
+                best = previous[j];
+            }
+            if (current[j - 1] < best) {
+                best = current[j - 1];
+            }
+            if (best != UINT32_MAX) {
+                current[j] = best + cost;
+            }
+        }
+
+        uint32_t *swap = previous;
+        previous = current;
+        current = swap;
+    }
+
+    if (previous[n_b] == UINT32_MAX) {
+        return UINT32_MAX;
+    }
+    return previous[n_b] / static_cast<uint32_t>(n_a + n_b);
+}
+
+}
+
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace fetap {
+
+/*
+    Fixed-point MFCC feature extraction for 16kHz mono audio. All tables are computed once in init(), the
+    per-frame work (pre-emphasis, Hamming window, 512 point FFT, mel filterbank, log and DCT) only uses
+    integer arithmetic since the C3 has no FPU.
+
+    The headers of this component do not depend on esp-idf or esphome and can be compiled on the host.
+*/
+class FetapMfcc {
+public:
+    static constexpr size_t kFrameLength{400}; /*!< Samples per analysis frame (25 ms) */
+    static constexpr size_t kFrameShift{160}; /*!< Samples between two frames (10 ms) */
+    static constexpr size_t kFftSize{512}; /*!< FFT length, frames are zero padded */
+    static constexpr size_t kNumFilters{20}; /*!< Number of mel filters */
+    static constexpr size_t kNumCoefficients{12}; /*!< Number of cepstral coefficients (c1..c12) */
+    static constexpr uint32_t kSampleRate{16000}; /*!< Sample rate of the audio */
+
+    /*
+        Features of a single frame
+    */
+    struct Frame {
+        int32_t cepstrum[kNumCoefficients]; /*!< Cepstral coefficients in log2 units with 8 fractional bits */
+        int32_t log_energy; /*!< Log2 of the frame energy with 8 fractional bits */
+    };
+
+    /*
+        Computes the window, twiddle, filterbank and DCT tables
+    */
+    void init(void);
+
+    /*
+        Drops buffered samples, the next frame starts with the next sample
+    */
+    void reset(void);
+
+    /*
+        Buffers the given samples and computes the features of each completed frame
+
+        \param  samples     Audio samples
+        \param  n_samples   Number of samples
+        \param  on_frame    Called with each completed Frame
+    */
+    template<typename F>
+    void process(const int16_t *samples, size_t n_samples, F &&on_frame) {
+        for (size_t i = 0; i < n_samples; i++) {
+            // Pre-emphasis y[n] = x[n] - 0.97 x[n-1]
+            const int32_t sample = samples[i];
+            buffer_[buffered_++] = sample - ((kPreEmphasisQ15 * previous_sample_) >> 15);
+            previous_sample_ = sample;
+
+            if (buffered_ == kFrameLength) {
+                on_frame(compute_frame_());
+                for (size_t j = kFrameShift; j < kFrameLength; j++) {
+                    buffer_[j - kFrameShift] = buffer_[j];
+                }
+                buffered_ = kFrameLength - kFrameShift;
+            }
+        }
+    }
+
+    /*
+        \returns    Integer log2 of value with 8 fractional bits, 0 for value 0
+    */
+    static int32_t log2_q8(uint64_t value);
+
+private:
+    static constexpr int32_t kPreEmphasisQ15{31785}; /*!< Pre-emphasis coefficient 0.97 in Q15 */
+    static constexpr size_t kNumBins{kFftSize / 2 + 1}; /*!< Number of non-redundant FFT bins */
+
+    /*
+        Computes the features of the buffered frame
+    */
+    const Frame &compute_frame_(void);
+
+    /*
+        In-place radix-2 FFT of re_/im_
+    */
+    void fft_(void);
+
+    int32_t buffer_[kFrameLength]; /*!< Pre-emphasized samples of the current frame */
+    size_t buffered_{0}; /*!< Number of samples in buffer_ */
+    int32_t previous_sample_{0}; /*!< Last sample for the pre-emphasis */
+    int16_t window_[kFrameLength]; /*!< Hamming window in Q15 */
+    int16_t cos_[kFftSize / 2]; /*!< FFT twiddle factors (cosine) in Q15 */
+    int16_t sin_[kFftSize / 2]; /*!< FFT twiddle factors (sine) in Q15 */
+    uint16_t bit_reverse_[kFftSize]; /*!< Bit reversed FFT input order */
+    uint16_t filter_start_[kNumFilters]; /*!< First FFT bin of each mel filter */
+    uint16_t filter_length_[kNumFilters]; /*!< Number of FFT bins of each mel filter */
+    std::vector<uint16_t> filter_weights_; /*!< Concatenated triangular filter weights in Q15 */
+    int16_t dct_[kNumCoefficients][kNumFilters]; /*!< DCT-II basis in Q15 */
+    int32_t re_[kFftSize]; /*!< FFT real part */
+    int32_t im_[kFftSize]; /*!< FFT imaginary part */
+    uint64_t power_[kNumBins]; /*!< Power spectrum */
+    Frame frame_; /*!< Features of the last frame */
+};
+
+/*
+    Energy based detection of utterances in a stream of frames. The noise floor follows the quietest
+    frames, an utterance starts after a few frames clearly above the floor and ends after a hangover
+    of quiet frames.
+*/
+class FetapUtteranceDetector {
+public:
+    /*
+        Result of feeding a frame to the detector
+    */
+    enum class Event : uint8_t {
+        NONE, /*!< no change */
+        STARTED, /*!< an utterance started, the frame and the kStartFrames - 1 frames before belong to it */
+        ENDED, /*!< the utterance ended, the last kHangoverFrames frames were silence */
+    };
+
+    static constexpr uint8_t kStartFrames{3}; /*!< Loud frames needed to start an utterance */
+    static constexpr uint8_t kHangoverFrames{20}; /*!< Quiet frames that end an utterance (200 ms) */
+
+    /*
+        \param  log_energy  Log2 frame energy with 8 fractional bits
+
+        \returns    The detection event caused by the frame
+    */
+    Event process(int32_t log_energy);
+
+    /*
+        Forgets an ongoing utterance, keeps the noise floor
+    */
+    void reset(void);
+
+    /*
+        \returns    True while an utterance is ongoing
+    */
+    bool in_utterance(void) const { return in_utterance_; }
+
+private:
+    static constexpr int32_t kStartThresholdQ8{3 << 8}; /*!< Frames 3 log2 units (18 dB) above the floor are loud */
+    static constexpr int32_t kEndThresholdQ8{2 << 8}; /*!< Frames less than 2 log2 units (12 dB) above the floor are quiet */
+    static constexpr int32_t kFloorRiseQ8{2}; /*!< Noise floor rise per frame, lets the floor recover from drops */
+
+    int32_t noise_floor_{INT32_MAX}; /*!< Current noise floor estimate */
+    uint8_t loud_frames_{0}; /*!< Consecutive loud frames */
+    uint8_t quiet_frames_{0}; /*!< Consecutive quiet frames during an utterance */
+    bool in_utterance_{false}; /*!< True while an utterance is ongoing */
+};
+
+/*
+    Removes the cepstral mean of an utterance and quantizes it to int8_t features, which are used for the
+    enrolled templates and the template matching.
+
+    \param  frames      Cepstral coefficients of all frames of the utterance
+    \param  n_frames    Number of frames
+    \param  features    Output, n_frames * FetapMfcc::kNumCoefficients features
+*/
+void fetap_normalize_features(const FetapMfcc::Frame *frames, size_t n_frames, int8_t *features);
+
+/*
+    Dynamic time warping distance between two feature sequences with a Sakoe-Chiba band. The local cost
+    is the L1 distance between frames, the result is normalized by the length of both sequences.
+
+    \param  a, n_a      First sequence of n_a frames of FetapMfcc::kNumCoefficients features
+    \param  b, n_b      Second sequence of n_b frames of FetapMfcc::kNumCoefficients features
+    \param  scratch     Scratch buffer, resized to 2 * (n_b + 1) entries
+
+    \returns    The normalized distance, UINT32_MAX if the sequence lengths are too different
+*/
+uint32_t fetap_dtw_distance(const int8_t *a, size_t n_a, const int8_t *b, size_t n_b, std::vector<uint32_t> &scratch);
+
+}
+}
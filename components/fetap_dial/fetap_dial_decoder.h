@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace fetap {
+
+/*
+    Timing of the pulses the rotary dial generates on the DIAL pin according to the IWV (Impulswahlverfahren).
+*/
+struct FetapDialTiming {
+    static constexpr uint16_t kPulseOpenMilliseconds{60}; /*!< Duration for which the sensor contact is open during each pulse */
+    static constexpr uint16_t kPulseClosedMilliseconds{40}; /*!< Duration for which the sensor contact is closed during each pulse */
+    static constexpr uint16_t kNumberDialGapMilliseconds{(kPulseOpenMilliseconds + kPulseClosedMilliseconds) * 2}; /*!< Minimum possible time between two consecutive dialed numbers */
+    static constexpr uint16_t kSamplesPerPulse{6}; /*!< Number of times the sensor pin is sampled during the conact open period of a pulse */
+    static constexpr uint16_t kSampleDelayMilliseconds{kPulseOpenMilliseconds / kSamplesPerPulse}; /*!< Delay between samples when the sensor contact is open */
+    static constexpr int8_t kMaxPulses{10}; /*!< Number of pulses of the digit 0 */
+    static constexpr uint16_t kPulseTrainIdleMilliseconds{100}; /*!< Time without a level change that ends the pulse train of a digit */
+    static constexpr uint16_t kMinPulseOpenMilliseconds{kPulseOpenMilliseconds / 3}; /*!< Shorter open periods are contact glitches, not pulses */
+    static constexpr uint16_t kMaxBounceMilliseconds{kPulseClosedMilliseconds / 4}; /*!< Shorter closed periods within a pulse are contact bounce */
+
+    // The pulse open period needs to be divisable by the number of samples per pulse.
+    static_assert(kPulseOpenMilliseconds % kSamplesPerPulse == 0);
+
+    /*
+        Converts the number of detected pulses to the dialed digit
+
+        \param  n_pulses    Number of detected pulses (at least 1)
+
+        \returns    The dialed digit as UTF-8 character
+    */
+    static char pulses_to_digit(int8_t n_pulses) { return static_cast<char>((n_pulses % 10) + 0x30); }
+};
+
+/*
+    A level change of the DIAL pin
+*/
+struct FetapDialEdge {
+    int64_t timestamp_us; /*!< Time of the level change */
+    bool level; /*!< Level of the DIAL pin after the change, HIGH means the contact is open */
+};
+
+/*
+    A digit decoded from the DIAL pin
+*/
+struct FetapDialDigit {
+    int64_t timestamp_us; /*!< Time at which the digit was complete */
+    char digit; /*!< The dialed digit as UTF-8 character */
+};
+
+/*
+    Counts the pulses of a single digit in one pass over the pulse train, as it is captured by the RMT
+    receiver. The signal is fed as consecutive periods of constant level. Contact bounce is suppressed:
+    short closed periods within a pulse are merged into the pulse and open periods that are too short
+    to be a pulse are ignored.
+*/
+class FetapDialPulseCounter {
+public:
+
+    /*
+        Adds the next period of constant level
+
+        \param  level           Level of the DIAL pin, HIGH means the contact is open
+        \param  duration_us     Duration of the period
+    */
+    void add(bool level, uint32_t duration_us) {
+        if (level) {
+            open_us_ += duration_us;
+            return;
+        }
+        if (open_us_ > 0 && duration_us < FetapDialTiming::kMaxBounceMilliseconds * 1000U) {
+            return;
+        }
+        finish_pulse_();
+    }
+
+    /*
+        Ends the pulse train
+
+        \returns    The number of pulses, the counter is reset for the next pulse train
+    */
+    int8_t finish(void) {
+        finish_pulse_();
+        const int8_t n_pulses = n_pulses_;
+        n_pulses_ = 0;
+        return n_pulses;
+    }
+
+private:
+    void finish_pulse_(void) {
+        if (open_us_ >= FetapDialTiming::kMinPulseOpenMilliseconds * 1000U && n_pulses_ < INT8_MAX) {
+            n_pulses_++;
+        }
+        open_us_ = 0;
+    }
+
+    uint32_t open_us_{0}; /*!< Open time of the current pulse */
+    int8_t n_pulses_{0}; /*!< Number of complete pulses */
+};
+
+/*
+    Reconstructs the DIAL pin edges of a pulse train captured by the RMT receiver. Each symbol holds two
+    periods of constant level, the receive ends with the idle LOW level of duration 0 as end marker. The
+    end marker is reported like every other level, so the signal returns to LOW after the last pulse.
+
+    \param  symbols     The captured symbols, any type with the fields of rmt_symbol_word_t
+    \param  n_symbols   Number of captured symbols
+    \param  tick_us     Duration of an RMT tick
+    \param  done_us     Time at which the receive ended, kPulseTrainIdleMilliseconds after the last edge
+    \param  on_edge     Called as on_edge(timestamp_us, level) for every level change in chronological order
+*/
+template<typename Symbol, typename F>
+inline void fetap_dial_rmt_edges(const Symbol *symbols, size_t n_symbols, uint32_t tick_us, int64_t done_us, F &&on_edge) {
+    int64_t duration_us{0};
+    for (size_t i = 0; i < n_symbols; i++) {
+        duration_us += static_cast<int64_t>(symbols[i].duration0 + symbols[i].duration1) * tick_us;
+    }
+
+    int64_t timestamp_us = done_us - FetapDialTiming::kPulseTrainIdleMilliseconds * 1000 - duration_us;
+    for (size_t i = 0; i < n_symbols; i++) {
+        on_edge(timestamp_us, static_cast<bool>(symbols[i].level0));
+        timestamp_us += static_cast<int64_t>(symbols[i].duration0) * tick_us;
+        if (symbols[i].duration0 == 0) {
+            // End marker in the first half, the second half is not part of the capture
+            break;
+        }
+        on_edge(timestamp_us, static_cast<bool>(symbols[i].level1));
+        timestamp_us += static_cast<int64_t>(symbols[i].duration1) * tick_us;
+    }
+}
+
+/*
+    Replays the sampling scheme of FetapDialSensor::sample_rotary_dial on a recorded DIAL pin signal. It is
+    used by the host replay tool to decode recorded traces exactly like the sensor task does on the device:
+    a rising edge while idle starts sampling, each pulse is sampled kSamplesPerPulse times during the open
+    period and the first pulse without a HIGH sample ends the digit. After a digit the sensor ignores the
+    pin for kNumberDialGapMilliseconds.
+
+    \param  edges   Level changes of the DIAL pin in chronological order, the pin is LOW before the first edge
+
+    \returns    The decoded digits
+*/
+inline std::vector<FetapDialDigit> fetap_dial_decode_sampled(const std::vector<FetapDialEdge> &edges) {
+    constexpr int64_t kSampleDelayUs{FetapDialTiming::kSampleDelayMilliseconds * 1000};
+    constexpr int64_t kPulseClosedUs{FetapDialTiming::kPulseClosedMilliseconds * 1000};
+    constexpr int64_t kDialGapUs{FetapDialTiming::kNumberDialGapMilliseconds * 1000};
+
+    std::vector<FetapDialDigit> digits;
+    size_t level_idx{0};
+    bool level{false};
+
+    // Level of the DIAL pin at time t, t must not decrease between calls
+    auto level_at = [&](int64_t t) {
+        while (level_idx < edges.size() && edges[level_idx].timestamp_us <= t) {
+            level = edges[level_idx].level;
+            level_idx++;
+        }
+        return level;
+    };
+
+    int64_t idle_from{INT64_MIN};
+    for (const FetapDialEdge &edge : edges) {
+        if (!edge.level || edge.timestamp_us < idle_from) {
+            continue;
+        }
+
+        int64_t t = edge.timestamp_us;
+        int8_t counter{-1};
+        for (; counter < FetapDialTiming::kMaxPulses; counter++) {
+            bool pin_was_high{false};
+            for (uint16_t sample_idx = 0; sample_idx < FetapDialTiming::kSamplesPerPulse; sample_idx++) {
+                pin_was_high |= level_at(t);
+                t += kSampleDelayUs;
+            }
+            if (!pin_was_high) {
+                break;
+            }
+            t += kPulseClosedUs;
+        }
+
+        if (counter >= 0) {
+            digits.push_back({t, FetapDialTiming::pulses_to_digit(counter + 1)});
+        }
+        idle_from = t + kDialGapUs;
+    }
+
+    return digits;
+}
+
+/*
+    Replays the RMT capture backend of the dial sensor on a recorded DIAL pin signal: a pulse train starts
+    with the first rising edge while idle and ends when the level does not change for
+    kPulseTrainIdleMilliseconds, its pulses are counted with FetapDialPulseCounter.
+
+    \param  edges   Level changes of the DIAL pin in chronological order, the pin is LOW before the first edge
+
+    \returns    The decoded digits
+*/
+inline std::vector<FetapDialDigit> fetap_dial_decode_pulse_train(const std::vector<FetapDialEdge> &edges) {
+    constexpr int64_t kIdleUs{FetapDialTiming::kPulseTrainIdleMilliseconds * 1000};
+
+    std::vector<FetapDialDigit> digits;
+    FetapDialPulseCounter counter;
+    bool in_train{false};
+
+    auto finish_train = [&](int64_t timestamp_us) {
+        const int8_t n_pulses = counter.finish();
+        if (n_pulses > 0 && n_pulses <= FetapDialTiming::kMaxPulses) {
+            digits.push_back({timestamp_us, FetapDialTiming::pulses_to_digit(n_pulses)});
+        }
+        in_train = false;
+    };
+
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (in_train) {
+            const int64_t duration_us = edges[i].timestamp_us - edges[i - 1].timestamp_us;
+            if (duration_us <= kIdleUs) {
+                counter.add(edges[i - 1].level, static_cast<uint32_t>(duration_us));
+                continue;
+            }
+            counter.add(edges[i - 1].level, static_cast<uint32_t>(kIdleUs));
+            finish_train(edges[i - 1].timestamp_us + kIdleUs);
+        }
+        in_train = edges[i].level;
+    }
+    if (in_train) {
+        counter.add(edges.back().level, static_cast<uint32_t>(kIdleUs));
+        finish_train(edges.back().timestamp_us + kIdleUs);
+    }
+
+    return digits;
+}
+
+}
+}
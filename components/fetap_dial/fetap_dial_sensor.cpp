@@ -1,6 +1,13 @@
 #include "fetap_dial_sensor.h"
 
+#include <atomic>
+#include <cinttypes>
+#include <cstring>
+
+#include <esp_timer.h>
+
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/timers.h"
 #include "esphome/core/log.h"
 
@@ -15,8 +22,22 @@ static TimerHandle_t timer_handle;
 static SemaphoreHandle_t rotary_dial_sampling_semaphore;
 static TickType_t t_rotary_dial_interrupt;
 static bool dialing_timeout_flag = false;
+static QueueHandle_t trace_edge_queue = nullptr;
+static std::atomic<uint32_t> trace_edges_dropped{0};
 
 static void IRAM_ATTR rotary_dial_sensor_isr_handler(void* arg) {
+    if (trace_edge_queue != nullptr) {
+        // Capture mode: the interrupt triggers on both edges so that every edge can be
+        // recorded, but only rising edges may start sampling.
+        const FetapDialEdge edge{esp_timer_get_time(), gpio_get_level(static_cast<gpio_num_t>(reinterpret_cast<intptr_t>(arg))) != 0};
+        if (xQueueSendFromISR(trace_edge_queue, &edge, NULL) != pdTRUE) {
+            trace_edges_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (!edge.level) {
+            return;
+        }
+    }
+
     // Unlock task loop if we are currently not sampling
     if(t_rotary_dial_interrupt == 0) {
         t_rotary_dial_interrupt = xTaskGetTickCountFromISR();
@@ -32,6 +53,13 @@ static void timer_publish_handler(TimerHandle_t timer) {
 void FetapDialSensor::setup() {
     esp_err_t err;
 
+#ifdef USE_FETAP_DIAL_RMT
+    if (backend_ == Backend::RMT) {
+        setup_rmt();
+        return;
+    }
+#endif
+
     err = gpio_install_isr_service(0);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error starting ISR service: %s", esp_err_to_name(err));
@@ -44,12 +72,21 @@ void FetapDialSensor::setup() {
     // Due to the way the rotary dial is wired up, the signal will be LOW when the rotary dial contact
     // is closed (default state when nothing is dialed) and the signal will be HIGH when the rotary dial 
     // contact is open (happens in short pulses when the dial is spinning back into position).
+    gpio_int_type_t intr_type{GPIO_INTR_POSEDGE};
+#ifdef USE_FETAP_TRACE
+    if (trace_ != nullptr) {
+        // Record falling edges as well, see rotary_dial_sensor_isr_handler
+        trace_edge_queue = xQueueCreate(kTraceEdgeQueueLength, sizeof(FetapDialEdge));
+        intr_type = GPIO_INTR_ANYEDGE;
+    }
+#endif
+
     const gpio_config_t sensor_pin_cfg {
         .pin_bit_mask = static_cast<uint64_t>(1) << dial_pin_,
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_POSEDGE
+        .intr_type = intr_type
     };
 
     err = gpio_config(&sensor_pin_cfg);
@@ -84,6 +121,47 @@ void FetapDialSensor::setup() {
     ESP_LOGI(TAG, "Fetap Dial Task initialized successfully.");
 }
 
+#if defined(USE_FETAP_TRACE) || defined(USE_FETAP_DIAL_RMT)
+void FetapDialSensor::loop() {
+#ifdef USE_FETAP_DIAL_RMT
+    if (rmt_queue_ != nullptr) {
+        while (xQueueReceive(rmt_queue_, &rmt_loop_train_, 0) == pdTRUE) {
+            handle_rmt_pulse_train(rmt_loop_train_);
+        }
+
+        const uint32_t n_dropped = rmt_trains_dropped_.exchange(0, std::memory_order_relaxed);
+        if (n_dropped > 0) {
+            ESP_LOGW(TAG, "Main loop was blocked, %" PRIu32 " dialed digit(s) were lost", n_dropped);
+            status_set_warning();
+        }
+        if (rmt_rearm_failed_.exchange(false, std::memory_order_relaxed)) {
+            start_rmt_receive();
+        }
+    }
+#endif
+
+#ifdef USE_FETAP_TRACE
+    if (trace_edge_queue != nullptr) {
+        // Edges are only dropped while the queue is full and only this loop empties it, so all queued
+        // edges were captured before the dropped ones. The gap is recorded right after them.
+        const uint32_t n_dropped = trace_edges_dropped.exchange(0, std::memory_order_relaxed);
+        const UBaseType_t n_before_gap = n_dropped > 0 ? uxQueueMessagesWaiting(trace_edge_queue) : 0;
+        FetapDialEdge edge;
+        for (UBaseType_t i = 0; i < n_before_gap && xQueueReceive(trace_edge_queue, &edge, 0) == pdTRUE; i++) {
+            trace_->record_dial_edge(edge.timestamp_us, edge.level);
+        }
+        if (n_dropped > 0) {
+            ESP_LOGW(TAG, "%" PRIu32 " DIAL pin edges did not fit into the trace queue", n_dropped);
+            trace_->record_dropped(n_dropped);
+        }
+        while (xQueueReceive(trace_edge_queue, &edge, 0) == pdTRUE) {
+            trace_->record_dial_edge(edge.timestamp_us, edge.level);
+        }
+    }
+#endif
+}
+#endif
+
 void FetapDialSensor::dial_task(void *params) {
     FetapDialSensor * instance = static_cast<FetapDialSensor *>(params);
 
@@ -113,16 +191,16 @@ void FetapDialSensor::task_loop(void) {
     }
     
     // Wait minimum time until next number can be dialed in
-    vTaskDelay(pdMS_TO_TICKS(kNumberDialGapMilliseconds));
+    vTaskDelay(pdMS_TO_TICKS(FetapDialTiming::kNumberDialGapMilliseconds));
 }
 
 void FetapDialSensor::sample_rotary_dial(void) {
-    const uint16_t tick_delay_closed{pdMS_TO_TICKS(kPulseClosedMilliseconds)};
-    const uint16_t tick_delay_sample{pdMS_TO_TICKS(kSampleDelayMilliseconds)};
+    const uint16_t tick_delay_closed{pdMS_TO_TICKS(FetapDialTiming::kPulseClosedMilliseconds)};
+    const uint16_t tick_delay_sample{pdMS_TO_TICKS(FetapDialTiming::kSampleDelayMilliseconds)};
 
     // Initialize counter with -1 to detect if no pulses were detected
     int8_t counter{-1};
-    for(; counter < 10; counter++) {
+    for(; counter < FetapDialTiming::kMaxPulses; counter++) {
         bool pin_was_high{false};
         
         // Sample the DIAL pin kSamplesPerPulse time while we expect the contact to
@@ -130,7 +208,7 @@ void FetapDialSensor::sample_rotary_dial(void) {
         // multiple times per pulse as the mechanical contacts of over 50 year old
         // telephones might not be in the best shape and provide an unreliable signal.
         // At least one sample needs to be high to confirm the presence of a pulse.
-        for (uint8_t sample_idx = 0; sample_idx < kSamplesPerPulse; sample_idx++) {
+        for (uint8_t sample_idx = 0; sample_idx < FetapDialTiming::kSamplesPerPulse; sample_idx++) {
             pin_was_high |= gpio_get_level(dial_pin_);
             xTaskDelayUntil(&t_rotary_dial_interrupt, tick_delay_sample);
         }
@@ -153,7 +231,13 @@ void FetapDialSensor::sample_rotary_dial(void) {
     }
 
     // Convert pulses to the dialed digit as UTF-8 character
-    const char dialed_digit = ((counter + 1) % 10) + 0x30;
+    const char dialed_digit = FetapDialTiming::pulses_to_digit(counter + 1);
+
+#ifdef USE_FETAP_TRACE
+    if (trace_ != nullptr) {
+        trace_->record_dial_digit(esp_timer_get_time(), dialed_digit);
+    }
+#endif
 
     // Add new digit to number
     dialed_number_ += std::string(1, dialed_digit);
@@ -176,6 +260,154 @@ void FetapDialSensor::publish_number(void) {
     // Reset timeout flag
     dialing_timeout_flag = false;
 }
+#ifdef USE_FETAP_DIAL_RMT
+void FetapDialSensor::setup_rmt() {
+    esp_err_t err;
 
+    rmt_queue_ = xQueueCreate(kRmtQueueLength, sizeof(RmtPulseTrain));
+    if (rmt_queue_ == nullptr) {
+        ESP_LOGE(TAG, "Error allocating RMT queue");
+        mark_failed();
+        status_set_error();
+        return;
+    }
+
+    // The XTAL clock is used since the channel divider can not reach the low resolution that
+    // is needed for the long pulses from the faster APB clock
+    rmt_rx_channel_config_t channel_cfg{};
+    channel_cfg.gpio_num = dial_pin_;
+    channel_cfg.clk_src = RMT_CLK_SRC_XTAL;
+    channel_cfg.resolution_hz = kRmtResolutionHz;
+    channel_cfg.mem_block_symbols = kRmtMemBlockSymbols;
+    err = rmt_new_rx_channel(&channel_cfg, &rmt_channel_);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error creating RMT channel: %s", esp_err_to_name(err));
+        mark_failed();
+        status_set_error();
+        return;
+    }
+
+    // Same wiring as for the GPIO backend, the contact pulls the DIAL pin LOW while it is closed
+    gpio_pullup_en(dial_pin_);
+
+    rmt_rx_event_callbacks_t callbacks{};
+    callbacks.on_recv_done = FetapDialSensor::rmt_receive_done;
+    err = rmt_rx_register_event_callbacks(rmt_channel_, &callbacks, this);
+    if (err == ESP_OK) {
+        err = rmt_enable(rmt_channel_);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error enabling RMT channel: %s", esp_err_to_name(err));
+        mark_failed();
+        status_set_error();
+        return;
+    }
+
+    // The receive ends as soon as the level does not change for kPulseTrainIdleMilliseconds, which
+    // is longer than the closed period between two pulses but shorter than the gap between two digits
+    rmt_receive_config_.signal_range_min_ns = kRmtGlitchFilterNanoseconds;
+    rmt_receive_config_.signal_range_max_ns = FetapDialTiming::kPulseTrainIdleMilliseconds * 1000000U;
+
+    start_rmt_receive();
+    ESP_LOGI(TAG, "Fetap Dial RMT receiver initialized successfully.");
+}
+
+void FetapDialSensor::start_rmt_receive() {
+    const esp_err_t err = rmt_receive(rmt_channel_, rmt_symbols_, sizeof(rmt_symbols_), &rmt_receive_config_);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error starting RMT receive: %s", esp_err_to_name(err));
+        status_set_warning();
+        return;
+    }
+    status_clear_warning();
+}
+
+bool IRAM_ATTR FetapDialSensor::rmt_receive_done(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *event, void *arg) {
+    FetapDialSensor *instance = static_cast<FetapDialSensor *>(arg);
+    RmtPulseTrain &train = instance->rmt_isr_train_;
+    constexpr uint32_t kTickMicroseconds{1000000 / kRmtResolutionHz};
+
+    // A symbol with zero duration marks the end of the pulse train, which the counter
+    // treats like any other closed period
+    FetapDialPulseCounter counter;
+    for (size_t i = 0; i < event->num_symbols; i++) {
+        const rmt_symbol_word_t &symbol = event->received_symbols[i];
+        counter.add(symbol.level0, symbol.duration0 * kTickMicroseconds);
+        counter.add(symbol.level1, symbol.duration1 * kTickMicroseconds);
+    }
+
+    // The driver drops the symbols that do not fit into the buffer but keeps receiving until the
+    // pulse train ends, so a full buffer means that the end of the train is missing
+    train.timestamp_us = esp_timer_get_time();
+    train.n_symbols = event->num_symbols;
+    train.n_pulses = counter.finish();
+    train.truncated = event->num_symbols >= kRmtMaxSymbols;
+#ifdef USE_FETAP_TRACE
+    if (instance->trace_ != nullptr) {
+        memcpy(train.symbols, event->received_symbols, event->num_symbols * sizeof(rmt_symbol_word_t));
+    }
+#endif
+
+    // The pulse train is copied into the queue, so the buffer can capture the next digit right away.
+    // The next pulse train may start 100 ms after this callback, the main loop may be blocked longer.
+    if (rmt_receive(channel, instance->rmt_symbols_, sizeof(instance->rmt_symbols_), &instance->rmt_receive_config_) != ESP_OK) {
+        instance->rmt_rearm_failed_.store(true, std::memory_order_relaxed);
+    }
+
+    BaseType_t task_woken{pdFALSE};
+    if (xQueueSendFromISR(instance->rmt_queue_, &train, &task_woken) != pdTRUE) {
+        instance->rmt_trains_dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return task_woken == pdTRUE;
+}
+
+void FetapDialSensor::handle_rmt_pulse_train(const RmtPulseTrain &train) {
+#ifdef USE_FETAP_TRACE
+    if (trace_ != nullptr) {
+        constexpr uint32_t kTickMicroseconds{1000000 / kRmtResolutionHz};
+        fetap_dial_rmt_edges(train.symbols, train.n_symbols, kTickMicroseconds, train.timestamp_us,
+                             [this](int64_t timestamp_us, bool level) { trace_->record_dial_edge(timestamp_us, level); });
+        if (train.truncated) {
+            trace_->record_dropped(1);
+        }
+    }
+#endif
+
+    if (train.truncated) {
+        // Counting the captured part would publish a wrong digit, the GPIO backend samples
+        // the pin instead of recording every bounce and is not affected
+        ESP_LOGW(TAG, "Ignoring pulse train with more than %u symbols, the dial contact bounces heavily. "
+                      "Consider the gpio backend.", static_cast<unsigned>(kRmtMaxSymbols));
+        status_set_warning();
+        return;
+    }
+    if (train.n_pulses == 0) {
+        // Only glitches were captured
+        return;
+    }
+    if (train.n_pulses > FetapDialTiming::kMaxPulses) {
+        ESP_LOGW(TAG, "Ignoring pulse train with %d pulses", train.n_pulses);
+        return;
+    }
+
+    const char dialed_digit = FetapDialTiming::pulses_to_digit(train.n_pulses);
+
+#ifdef USE_FETAP_TRACE
+    if (trace_ != nullptr) {
+        trace_->record_dial_digit(train.timestamp_us, dialed_digit);
+    }
+#endif
+
+    dialed_number_ += std::string(1, dialed_digit);
+
+    if (dial_timeout_) {
+        // Restarts the timeout with every digit
+        set_timeout("publish", dial_timeout_, [this]() { publish_number(); });
+    } else {
+        publish_number();
+    }
+}
+#endif
+
+}
 }
-}
\ No newline at end of file
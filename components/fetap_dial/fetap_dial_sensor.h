@@ -1,9 +1,24 @@
 #pragma once
 
+#include <atomic>
+
 #include <driver/gpio.h>
 
 #include "esphome/components/text_sensor/text_sensor.h"
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
+
+#include "fetap_dial_decoder.h"
+
+#ifdef USE_FETAP_DIAL_RMT
+#include <driver/rmt_rx.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#endif
+
+#ifdef USE_FETAP_TRACE
+#include "../fetap_trace/fetap_trace.h"
+#endif
 
 namespace esphome {
 namespace fetap {
@@ -14,6 +29,15 @@ namespace fetap {
 */
 class FetapDialSensor : public text_sensor::TextSensor, public Component {
 public:
+
+    /*
+        Possible ways of capturing the pulses of the rotary dial
+    */
+    enum class Backend : uint8_t {
+        GPIO, /*!< a high priority task samples the DIAL pin after an interrupt */
+        RMT, /*!< the RMT receiver captures the complete pulse train of a digit in hardware */
+    };
+
     /* --------------------------- Functions inherited from component interface --------------------------- */
 
     /*
@@ -21,6 +45,14 @@ public:
     */
     void setup() override;
 
+#if defined(USE_FETAP_TRACE) || defined(USE_FETAP_DIAL_RMT)
+    /*
+        Called repeatedly, forwards the DIAL pin edges captured by the interrupt to the trace
+        and handles the pulse trains decoded by the RMT receiver
+    */
+    void loop() override;
+#endif
+
     /* --------------------------- Functions triggered from code generation --------------------------- */
 
     /*
@@ -37,6 +69,22 @@ public:
     */
     void set_dial_timeout(int timeout_ms) {dial_timeout_ = static_cast<uint32_t>(timeout_ms); }
 
+    /*
+        Sets how the pulses of the rotary dial are captured
+
+        \param  backend     The capture backend
+    */
+    void set_backend(Backend backend) { backend_ = backend; }
+
+#ifdef USE_FETAP_TRACE
+    /*
+        Records all DIAL pin edges and published digits into the given trace
+
+        \param  trace   The trace recorder
+    */
+    void set_trace(FetapTrace *trace) { trace_ = trace; }
+#endif
+
 private:
 
     /*
@@ -66,20 +114,77 @@ private:
     */
     void publish_number(void);
 
-    static constexpr uint16_t kPulseOpenMilliseconds{60}; /*!< Duration for which the sensor contact is open during each pulse */
-    static constexpr uint16_t kPulseClosedMilliseconds{40}; /*!< Duration for which the sensor contact is closed during each pulse */
-    static constexpr uint16_t kNumberDialGapMilliseconds{(kPulseOpenMilliseconds + kPulseClosedMilliseconds) * 2}; /*!< Minimum possible time between two consecutive dialed numbers */
-    static constexpr uint16_t kSamplesPerPulse{6}; /*!< Number of times the sensor pin is sampled during the conact open period of a pulse */
-    static constexpr uint16_t kSampleDelayMilliseconds{kPulseOpenMilliseconds / kSamplesPerPulse}; /*!< Delay between samples when the sensor contact is open */
-    static constexpr uint32_t kDefaultDialTimeoutMilliseconds{0}; /*!< The default time to wait for another number to be dialed before publishing the new state */
+#ifdef USE_FETAP_DIAL_RMT
+    static constexpr uint32_t kRmtResolutionHz{200000}; /*!< RMT tick of 5 us, the longest level that can be captured is 163 ms */
+    static constexpr uint32_t kRmtGlitchFilterNanoseconds{3000}; /*!< Shorter pulses are removed by the hardware filter of the RMT receiver. The filter
+                                                                      only removes spikes, on the C3 it is limited to about 6.4 us (255 ticks of the
+                                                                      40 MHz XTAL clock). Contact bounce lasts milliseconds, every bounce is captured
+                                                                      as a symbol of its own and merged by FetapDialPulseCounter. */
+    static constexpr size_t kRmtMemBlockSymbols{48}; /*!< One RMT memory block, the driver copies it to rmt_symbols_ in ping-pong halves */
+    static constexpr size_t kRmtMaxSymbols{256}; /*!< Symbols per pulse train. A digit needs kMaxPulses + 1 symbols without bounce and
+                                                      one more for every bounce, this leaves room for about 12 bounces per edge. */
+    static constexpr uint8_t kRmtQueueLength{2}; /*!< Pulse trains buffered for the main loop, the receiver is re-armed without it */
+
+    /*
+        Pulse train of a digit decoded by the RMT receive-done callback
+    */
+    struct RmtPulseTrain {
+        int64_t timestamp_us; /*!< Time at which the pulse train was complete */
+        size_t n_symbols; /*!< Number of captured RMT symbols */
+        int8_t n_pulses; /*!< Number of pulses */
+        bool truncated; /*!< True if the pulse train did not fit into rmt_symbols_, n_pulses is not reliable */
+#ifdef USE_FETAP_TRACE
+        rmt_symbol_word_t symbols[kRmtMaxSymbols]; /*!< Copy of the captured symbols for the trace, only filled if a trace is used */
+#endif
+    };
+
+    /*
+        Configures the RMT receiver on the DIAL pin and starts the first capture
+    */
+    void setup_rmt(void);
+
+    /*
+        Starts capturing the next pulse train into rmt_symbols_. Used for the first capture and to retry
+        if the receive-done callback could not re-arm the receiver.
+    */
+    void start_rmt_receive(void);
+
+    /*
+        Adds the digit of a pulse train decoded by the RMT receiver to the dialed number
+
+        \param  train   The decoded pulse train
+    */
+    void handle_rmt_pulse_train(const RmtPulseTrain &train);
 
-    // The pulse open period needs to be divisable by the number of samples per pulse.
-    static_assert(kPulseOpenMilliseconds % kSamplesPerPulse == 0);
+    /*
+        Called by the RMT driver in interrupt context when a pulse train is complete. Counts the
+        pulses in a single pass over the captured symbols, passes the result to the main loop and
+        re-arms the receiver right away, so a stalled main loop does not miss the next digit.
+    */
+    static bool rmt_receive_done(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *event, void *arg);
+#endif
+
+    static constexpr uint32_t kDefaultDialTimeoutMilliseconds{0}; /*!< The default time to wait for another number to be dialed before publishing the new state */
+    static constexpr uint8_t kTraceEdgeQueueLength{64}; /*!< Number of DIAL pin edges buffered between the interrupt and the trace */
 
     std::string dialed_number_{""}; /*!< String that holds the dialed number */
     uint32_t dial_timeout_{kDefaultDialTimeoutMilliseconds}; /*!< Maximum time to wait for next digit before publishing */
     gpio_num_t dial_pin_{GPIO_NUM_NC}; /*!< DIAL pin of the rotary dial */
     TaskHandle_t task_handle_{nullptr}; /*!< Reference to the sensor task */
+    Backend backend_{Backend::GPIO}; /*!< How the pulses are captured */
+#ifdef USE_FETAP_DIAL_RMT
+    rmt_channel_handle_t rmt_channel_{nullptr}; /*!< RMT receive channel on the DIAL pin */
+    rmt_symbol_word_t rmt_symbols_[kRmtMaxSymbols]; /*!< Captured pulse train, owned by the RMT driver until the receive is done */
+    rmt_receive_config_t rmt_receive_config_{}; /*!< Receive configuration, also used by the receive-done callback to re-arm */
+    QueueHandle_t rmt_queue_{nullptr}; /*!< Pulse trains passed from the receive-done callback to the main loop */
+    RmtPulseTrain rmt_isr_train_; /*!< Pulse train assembled by the receive-done callback, too large for the interrupt stack */
+    RmtPulseTrain rmt_loop_train_; /*!< Pulse train received by the main loop */
+    std::atomic<bool> rmt_rearm_failed_{false}; /*!< Set by the receive-done callback if the receiver could not be re-armed */
+    std::atomic<uint32_t> rmt_trains_dropped_{0}; /*!< Pulse trains that did not fit into rmt_queue_ */
+#endif
+#ifdef USE_FETAP_TRACE
+    FetapTrace *trace_{nullptr}; /*!< Trace recorder for DIAL pin edges, if used */
+#endif
 };
 
 }
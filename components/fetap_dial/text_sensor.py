@@ -5,16 +5,27 @@ from esphome.components import text_sensor
 
 CONF_DIAL_PIN = "dial_pin"
 CONF_DIAL_TIMEOUT = "dial_timeout"
+CONF_FETAP_TRACE_ID = "fetap_trace_id"
+CONF_BACKEND = "backend"
 
 fetap_ns = cg.esphome_ns.namespace("fetap")
 FetapDialSensor = fetap_ns.class_(
     "FetapDialSensor", text_sensor.TextSensor, cg.Component
 )
+FetapTrace = fetap_ns.class_("FetapTrace", cg.Component)
+Backend = FetapDialSensor.enum("Backend", is_class=True)
+
+BACKENDS = {
+    "gpio": Backend.GPIO,
+    "rmt": Backend.RMT,
+}
 
 CONFIG_SCHEMA = text_sensor.text_sensor_schema(FetapDialSensor).extend(
     {
         cv.Required(CONF_DIAL_PIN): pins.internal_gpio_output_pin_number,
-        cv.Optional(CONF_DIAL_TIMEOUT, default=0): cv.int_range(min=0, max=1000000)
+        cv.Optional(CONF_DIAL_TIMEOUT, default=0): cv.int_range(min=0, max=1000000),
+        cv.Optional(CONF_BACKEND, default="gpio"): cv.enum(BACKENDS, lower=True),
+        cv.Optional(CONF_FETAP_TRACE_ID): cv.use_id(FetapTrace),
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
@@ -25,3 +36,12 @@ async def to_code(config):
 
     cg.add(var.set_dial_pin(config[CONF_DIAL_PIN]))
     cg.add(var.set_dial_timeout(config[CONF_DIAL_TIMEOUT]))
+    cg.add(var.set_backend(config[CONF_BACKEND]))
+
+    # The RMT driver is only linked in if the RMT backend is used
+    if config[CONF_BACKEND] == "rmt":
+        cg.add_define("USE_FETAP_DIAL_RMT")
+
+    if CONF_FETAP_TRACE_ID in config:
+        trace = await cg.get_variable(config[CONF_FETAP_TRACE_ID])
+        cg.add(var.set_trace(trace))
@@ -0,0 +1,100 @@
+import math
+
+import esphome.codegen as cg
+import esphome.config_validation as cv
+
+CONF_PROCESSING = "processing"
+CONF_GAIN = "gain"
+CONF_DC_BLOCK = "dc_block"
+CONF_HIGH_PASS = "high_pass"
+CONF_LIMITER = "limiter"
+CONF_THRESHOLD = "threshold"
+CONF_RELEASE = "release"
+
+# Sample rate of the fetap microphone and speaker
+SAMPLE_RATE = 16000
+
+DSP_NS = "esphome::fetap::dsp"
+
+STAGE_KEYS = [CONF_GAIN, CONF_DC_BLOCK, CONF_HIGH_PASS, CONF_LIMITER]
+
+LIMITER_SCHEMA = cv.maybe_simple_value(
+    {
+        # Threshold in dBFS of the int16 sample range
+        cv.Optional(CONF_THRESHOLD, default=-1.0): cv.float_range(min=-60.0, max=0.0),
+        cv.Optional(
+            CONF_RELEASE, default="50ms"
+        ): cv.positive_time_period_milliseconds,
+    },
+    key=CONF_THRESHOLD,
+)
+
+STAGE_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            # Gain in dB
+            cv.Optional(CONF_GAIN): cv.float_range(min=-60.0, max=24.0),
+            # Pole radius of the DC blocking filter
+            cv.Optional(CONF_DC_BLOCK): cv.float_range(min=0.9, max=0.9999),
+            # Cutoff frequency of the high-pass filter
+            cv.Optional(CONF_HIGH_PASS): cv.All(
+                cv.frequency, cv.float_range(min=10.0, max=SAMPLE_RATE / 4)
+            ),
+            cv.Optional(CONF_LIMITER): LIMITER_SCHEMA,
+        }
+    ),
+    cv.has_exactly_one_key(*STAGE_KEYS),
+)
+
+PROCESSING_SCHEMA = cv.ensure_list(STAGE_SCHEMA)
+
+# The stages are only compiled in through the headers of this component
+CONFIG_SCHEMA = cv.Schema({})
+
+
+def _q(value, bits):
+    return int(round(value * (1 << bits)))
+
+
+def _gain_type(gain_db):
+    return f"{DSP_NS}::Gain<{_q(10 ** (gain_db / 20), 16)}>"
+
+
+def _dc_block_type(pole):
+    return f"{DSP_NS}::DcBlock<{_q(pole, 15)}>"
+
+
+def _high_pass_type(cutoff):
+    # RBJ audio EQ cookbook high-pass with Q = 1/sqrt(2) (Butterworth)
+    w0 = 2 * math.pi * cutoff / SAMPLE_RATE
+    alpha = math.sin(w0) / (2 * (1 / math.sqrt(2)))
+    a0 = 1 + alpha
+    b0 = (1 + math.cos(w0)) / 2 / a0
+    b1 = -(1 + math.cos(w0)) / a0
+    b2 = b0
+    a1 = -2 * math.cos(w0) / a0
+    a2 = (1 - alpha) / a0
+    coefficients = ", ".join(str(_q(c, 28)) for c in (b0, b1, b2, a1, a2))
+    return f"{DSP_NS}::HighPass<{coefficients}>"
+
+
+def _limiter_type(config):
+    threshold = _q(10 ** (config[CONF_THRESHOLD] / 20), 15)
+    release_samples = config[CONF_RELEASE].total_milliseconds * SAMPLE_RATE / 1000
+    release = max(1, _q(1 - math.exp(-1 / release_samples), 15))
+    return f"{DSP_NS}::Limiter<{min(threshold, 32767)}, {release}>"
+
+
+def chain_type(stages):
+    """Returns the C++ type of the processing chain for the given list of validated stages."""
+    types = []
+    for stage in stages:
+        if CONF_GAIN in stage:
+            types.append(_gain_type(stage[CONF_GAIN]))
+        elif CONF_DC_BLOCK in stage:
+            types.append(_dc_block_type(stage[CONF_DC_BLOCK]))
+        elif CONF_HIGH_PASS in stage:
+            types.append(_high_pass_type(stage[CONF_HIGH_PASS]))
+        elif CONF_LIMITER in stage:
+            types.append(_limiter_type(stage[CONF_LIMITER]))
+    return f"{DSP_NS}::Chain<{', '.join(types)}>"
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+
+namespace esphome {
+namespace fetap {
+namespace dsp {
+
+/*
+    Audio processing stages for the fetap microphone and speaker. All parameters are fixed-point template
+    arguments computed during code generation (the C3 has no FPU), so each stage is a plain inline function
+    of a single int32_t sample and a chain of stages compiles into one per-sample loop. Samples are in the
+    int16_t range, stages may exceed it and the caller saturates once at the end of the chain.
+
+    The headers of this component do not depend on esp-idf or esphome and can be compiled on the host.
+*/
+
+/*
+    Multiplies each sample with a constant gain.
+
+    \tparam GainQ16     Linear gain factor in Q16 (65536 = 0 dB)
+*/
+template<int32_t GainQ16>
+class Gain {
+public:
+    int32_t process(int32_t sample) {
+        return static_cast<int32_t>((static_cast<int64_t>(sample) * GainQ16) >> 16);
+    }
+};
+
+/*
+    First order DC blocking filter y[n] = x[n] - x[n-1] + R * y[n-1]. The output state is kept
+    with additional fractional bits to avoid truncation limit cycles.
+
+    \tparam PoleQ15     Pole radius R in Q15, the closer to 1 the lower the corner frequency
+*/
+template<int32_t PoleQ15>
+class DcBlock {
+public:
+    int32_t process(int32_t sample) {
+        // Scaled by multiplication, a left shift of the negative difference would be undefined
+        y_ = static_cast<int32_t>(static_cast<int64_t>(sample - x_) * (int64_t{1} << kFractionalBits) +
+                                  ((static_cast<int64_t>(y_) * PoleQ15) >> 15));
+        x_ = sample;
+        return y_ >> kFractionalBits;
+    }
+
+private:
+    static constexpr int kFractionalBits{8}; /*!< Number of fractional bits of the output state */
+
+    int32_t x_{0}; /*!< Previous input sample */
+    int32_t y_{0}; /*!< Previous output sample with kFractionalBits fractional bits */
+};
+
+/*
+    Second order Butterworth high-pass filter (direct form I biquad). With low cutoff frequencies the poles
+    are close to the unit circle, so the output state is kept with additional fractional bits to avoid a
+    dead band around DC.
+
+    \tparam B0, B1, B2  Feed-forward coefficients in Q28
+    \tparam A1, A2      Feedback coefficients in Q28 (a0 normalized to 1)
+*/
+template<int32_t B0, int32_t B1, int32_t B2, int32_t A1, int32_t A2>
+class HighPass {
+public:
+    int32_t process(int32_t sample) {
+        const int64_t acc = (static_cast<int64_t>(B0) * sample + static_cast<int64_t>(B1) * x1_ + static_cast<int64_t>(B2) * x2_) * (int64_t{1} << kFractionalBits)
+                          - static_cast<int64_t>(A1) * y1_ - static_cast<int64_t>(A2) * y2_;
+        x2_ = x1_;
+        x1_ = sample;
+        y2_ = y1_;
+        y1_ = static_cast<int32_t>((acc + kRounding) >> 28);
+        return y1_ >> kFractionalBits;
+    }
+
+private:
+    static constexpr int kFractionalBits{8}; /*!< Number of fractional bits of the output state */
+    static constexpr int64_t kRounding{static_cast<int64_t>(1) << 27}; /*!< Rounds instead of truncating the Q28 accumulator */
+
+    int32_t x1_{0}; /*!< Input sample x[n-1] */
+    int32_t x2_{0}; /*!< Input sample x[n-2] */
+    int32_t y1_{0}; /*!< Output sample y[n-1] with kFractionalBits fractional bits */
+    int32_t y2_{0}; /*!< Output sample y[n-2] with kFractionalBits fractional bits */
+};
+
+/*
+    Peak limiter with instant attack and exponential release. The gain drops just far enough that a sample
+    above the threshold ends up at the threshold and then recovers towards unity, so the output never exceeds
+    the threshold. The gain is only recomputed when a sample would exceed the threshold, with a 32 bit
+    division (a single instruction on the C3), every other sample only needs multiplications.
+
+    \tparam Threshold   Maximum absolute sample value
+    \tparam ReleaseQ15  Gain release coefficient per sample in Q15
+*/
+template<int32_t Threshold, int32_t ReleaseQ15>
+class Limiter {
+public:
+    int32_t process(int32_t sample) {
+        const int32_t magnitude = sample < 0 ? -sample : sample;
+        if (((static_cast<int64_t>(magnitude) * gain_q30_) >> 30) > Threshold) {
+            gain_q30_ = static_cast<int32_t>(((static_cast<uint32_t>(Threshold) << 15) / static_cast<uint32_t>(magnitude)) << 15);
+        }
+        const int32_t output = static_cast<int32_t>((static_cast<int64_t>(sample) * gain_q30_) >> 30);
+        // Rounded up, so the gain reaches unity exactly and unlimited samples pass unchanged again
+        gain_q30_ += static_cast<int32_t>((static_cast<int64_t>(kUnityQ30 - gain_q30_) * ReleaseQ15 + kRoundUp) >> 15);
+        return output;
+    }
+
+private:
+    static constexpr int32_t kUnityQ30{1 << 30}; /*!< Gain of 1.0 in Q30 */
+    static constexpr int64_t kRoundUp{(1 << 15) - 1}; /*!< Rounds the release step up */
+
+    int32_t gain_q30_{kUnityQ30}; /*!< Current gain in Q30 */
+};
+
+/*
+    Composes the given stages into a single per-sample function. The stage list is fixed at compile
+    time, so stages that are not configured do not exist in the binary and the compiler inlines all
+    configured stages into the sample loop of the caller.
+
+    \tparam Stages  Processing stages in the order they are applied
+*/
+template<typename... Stages>
+class Chain {
+public:
+    static constexpr size_t kNumStages{sizeof...(Stages)}; /*!< Number of stages in the chain */
+
+    int32_t process(int32_t sample) { return process_<0>(sample); }
+
+private:
+    template<size_t I>
+    int32_t process_(int32_t sample) {
+        if constexpr (I == kNumStages) {
+            return sample;
+        } else {
+            return process_<I + 1>(std::get<I>(stages_).process(sample));
+        }
+    }
+
+    std::tuple<Stages...> stages_; /*!< State of all stages */
+};
+
+/*
+    Converts a raw 32 bit I2S sample of the INMP441 microphone to a saturated 16 bit sample, running the
+    given chain on the way. Used by the fetap microphone and the host replay tool.
+
+    \param  chain   The processing chain
+    \param  raw     The raw 32 bit I2S sample
+
+    \returns    The processed 16 bit sample
+*/
+template<typename ChainT>
+inline int16_t process_microphone_sample(ChainT &chain, int32_t raw) {
+    const int32_t sample = chain.process(raw >> 13);
+    return static_cast<int16_t>(sample < INT16_MIN ? INT16_MIN : (sample > INT16_MAX ? INT16_MAX : sample));
+}
+
+}
+}
+}
@@ -0,0 +1,38 @@
+from esphome import pins
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.const import (
+    CONF_ID,
+)
+
+CONF_FETAP_I2S_ID = "fetap_i2s_id"
+CONF_I2S_LRCLK_PIN = "i2s_lrclk_pin"
+CONF_I2S_BCLK_PIN = "i2s_bclk_pin"
+CONF_I2S_DIN_PIN = "i2s_din_pin"
+CONF_I2S_DOUT_PIN = "i2s_dout_pin"
+
+fetap_ns = cg.esphome_ns.namespace("fetap")
+FetapI2S = fetap_ns.class_("FetapI2S", cg.Component)
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(FetapI2S),
+        cv.Required(CONF_I2S_LRCLK_PIN): pins.internal_gpio_output_pin_number,
+        cv.Required(CONF_I2S_BCLK_PIN): pins.internal_gpio_output_pin_number,
+        cv.Required(CONF_I2S_DIN_PIN): pins.internal_gpio_output_pin_number,
+        cv.Required(CONF_I2S_DOUT_PIN): pins.internal_gpio_output_pin_number,
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    # The fetap microphone and speaker only include the duplex owner if it is configured
+    cg.add_define("USE_FETAP_I2S")
+
+    cg.add(var.set_din_pin(config[CONF_I2S_DIN_PIN]))
+    cg.add(var.set_dout_pin(config[CONF_I2S_DOUT_PIN]))
+    cg.add(var.set_bclk_pin(config[CONF_I2S_BCLK_PIN]))
+    cg.add(var.set_lrclk_pin(config[CONF_I2S_LRCLK_PIN]))
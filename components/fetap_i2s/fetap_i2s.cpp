@@ -0,0 +1,88 @@
+#include "fetap_i2s.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+
+namespace fetap {
+
+static const char *const TAG = "fetap.i2s";
+
+void FetapI2S::setup(void) {
+    esp_err_t err;
+    i2s_chan_handle_t tx_channel{nullptr};
+    i2s_chan_handle_t rx_channel{nullptr};
+
+    // Passing both handles allocates the TX and RX channel on the same controller,
+    // which is what makes them share the BCLK and WS signals. auto_clear makes the
+    // TX DMA send silence instead of repeating the last buffer when the speaker
+    // has nothing to play, so TX can stay enabled all the time.
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
+    chan_cfg.auto_clear = true;
+    err = i2s_new_channel(&chan_cfg, &tx_channel, &rx_channel);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error creating I2S channel pair: %s", esp_err_to_name(err));
+        mark_failed();
+        status_set_error();
+        return;
+    }
+
+    i2s_std_config_t std_cfg = {
+        .clk_cfg  = I2S_STD_CLK_DEFAULT_CONFIG(kSampleRate),
+        .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(kSlotBitWidth, I2S_SLOT_MODE_MONO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = bclk_pin_,
+            .ws   = lrclk_pin_,
+            .dout = dout_pin_,
+            .din  = din_pin_,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv   = false,
+            },
+        },
+    };
+    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+
+    // Both channels have to be initialized with the same clock and slot configuration
+    err = i2s_channel_init_std_mode(tx_channel, &std_cfg);
+    if (err == ESP_OK) {
+        err = i2s_channel_init_std_mode(rx_channel, &std_cfg);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error initializing I2S channel pair: %s", esp_err_to_name(err));
+        i2s_del_channel(tx_channel);
+        i2s_del_channel(rx_channel);
+        mark_failed();
+        status_set_error();
+        return;
+    }
+
+    // Enable TX before RX so that both channels start on the same WS edge. From here on
+    // the channels are never disabled again, which avoids re-enable glitches and keeps
+    // capture and playback sample aligned.
+    err = i2s_channel_enable(tx_channel);
+    if (err == ESP_OK) {
+        err = i2s_channel_enable(rx_channel);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error enabling I2S channel pair: %s", esp_err_to_name(err));
+        i2s_channel_disable(tx_channel);
+        i2s_del_channel(tx_channel);
+        i2s_del_channel(rx_channel);
+        mark_failed();
+        status_set_error();
+        return;
+    }
+
+    i2s_tx_channel_ = tx_channel;
+    i2s_rx_channel_ = rx_channel;
+
+    ESP_LOGI(TAG, "Fetap I2S full-duplex channel pair initialized successfully.");
+}
+
+}
+
+}
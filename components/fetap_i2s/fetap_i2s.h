@@ -0,0 +1,90 @@
+#pragma once
+
+#include <driver/i2s_std.h>
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace fetap {
+
+/*
+    The fetap I2S class owns a full-duplex TX+RX channel pair on the single I2S controller of the C3/C6.
+    Both channels share the BCLK and LRCLK/WS pins, so playback and capture run on the same clock and
+    every RX frame is aligned with a TX frame. The channels are enabled once during setup and stay
+    enabled, the fetap microphone and speaker only start and stop consuming/producing data.
+*/
+class FetapI2S : public Component {
+public:
+
+    /* --------------------------- Functions inherited from component interface --------------------------- */
+
+    /*
+        Called initially to create and enable the full-duplex channel pair
+    */
+    void setup(void) override;
+
+    /*
+        The channel pair needs to be available before the fetap microphone and speaker are set up
+
+        \returns    The bus setup priority
+    */
+    float get_setup_priority() const override { return setup_priority::BUS; }
+
+    /* --------------------------- Functions used by the fetap microphone and speaker --------------------------- */
+
+    /*
+        \returns    The RX channel handle of the channel pair or nullptr if setup failed
+    */
+    i2s_chan_handle_t get_rx_channel(void) const { return i2s_rx_channel_; }
+
+    /*
+        \returns    The TX channel handle of the channel pair or nullptr if setup failed
+    */
+    i2s_chan_handle_t get_tx_channel(void) const { return i2s_tx_channel_; }
+
+    /* --------------------------- Functions triggered from code generation --------------------------- */
+
+    /*
+        Sets the DIN pin of I2S bus
+
+        \param  pin     The DIN GPIO pin of the I2S bus
+    */
+    void set_din_pin(int pin) { din_pin_ = static_cast<gpio_num_t>(pin); }
+
+    /*
+        Sets the DOUT pin of I2S bus
+
+        \param  pin     The DOUT GPIO pin of the I2S bus
+    */
+    void set_dout_pin(int pin) { dout_pin_ = static_cast<gpio_num_t>(pin); }
+
+    /*
+        Sets the BLCK pin of I2S bus
+
+        \param  pin     The BLCK GPIO pin of the I2S bus
+    */
+    void set_bclk_pin(int pin) { bclk_pin_ = static_cast<gpio_num_t>(pin); }
+
+    /*
+        Sets the LRCLK/WS pin of I2S bus
+
+        \param  pin     The LRCLK/WS GPIO pin of the I2S bus
+    */
+    void set_lrclk_pin(int pin) { lrclk_pin_ = static_cast<gpio_num_t>(pin); }
+
+    static constexpr uint32_t kSampleRate{16000}; /*!< Sample rate shared by both channels */
+    static constexpr i2s_data_bit_width_t kSlotBitWidth{I2S_DATA_BIT_WIDTH_32BIT}; /*!<    Slot width shared by both channels. The microphone
+                                                                                            needs 32 bit slots, so the speaker has to write
+                                                                                            32 bit samples as well. */
+
+private:
+    gpio_num_t din_pin_{I2S_GPIO_UNUSED}; /*!< DIN pin of I2S bus */
+    gpio_num_t dout_pin_{I2S_GPIO_UNUSED}; /*!< DOUT pin of I2S bus */
+    gpio_num_t bclk_pin_{I2S_GPIO_UNUSED}; /*!< BCLK pin of the I2S bus */
+    gpio_num_t lrclk_pin_{I2S_GPIO_UNUSED}; /*!< LRCLK/WS pin of the I2S bus */
+    i2s_chan_handle_t i2s_rx_channel_{nullptr}; /*!< RX channel handle of I2S peripheral */
+    i2s_chan_handle_t i2s_tx_channel_{nullptr}; /*!< TX channel handle of I2S peripheral */
+};
+
+}
+}
@@ -0,0 +1,110 @@
+#include "fetap_audio_block.h"
+
+#include <new>
+#include <utility>
+
+namespace esphome {
+
+namespace fetap {
+
+void FetapAudioBlock::release(void) {
+    if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pool_->recycle_(this);
+    }
+}
+
+bool FetapAudioBlockPool::allocate(size_t n_blocks, size_t capacity) {
+    if (is_allocated() || n_blocks == 0) {
+        return false;
+    }
+
+    // Everything is allocated before it is assigned, so a failure leaves the pool unallocated
+    QueueHandle_t free_blocks = xQueueCreate(n_blocks, sizeof(FetapAudioBlock *));
+    if (free_blocks == nullptr) {
+        return false;
+    }
+
+    std::unique_ptr<FetapAudioBlock[]> blocks(new (std::nothrow) FetapAudioBlock[n_blocks]);
+    bool allocated = blocks != nullptr;
+    for (size_t i = 0; allocated && i < n_blocks; i++) {
+        blocks[i].samples_.reset(new (std::nothrow) int16_t[capacity]);
+        allocated = blocks[i].samples_ != nullptr;
+    }
+    if (!allocated) {
+        vQueueDelete(free_blocks);
+        return false;
+    }
+
+    for (size_t i = 0; i < n_blocks; i++) {
+        FetapAudioBlock *block = &blocks[i];
+        block->pool_ = this;
+        xQueueSend(free_blocks, &block, 0);
+    }
+    blocks_ = std::move(blocks);
+    free_blocks_ = free_blocks;
+
+    return true;
+}
+
+FetapAudioBlock *FetapAudioBlockPool::acquire(uint32_t sequence) {
+    FetapAudioBlock *block{nullptr};
+    if (xQueueReceive(free_blocks_, &block, 0) != pdTRUE) {
+        exhausted_count_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    block->size_ = 0;
+    block->sequence_ = sequence;
+    block->references_.store(1, std::memory_order_relaxed);
+    return block;
+}
+
+void FetapAudioBlockPool::recycle_(FetapAudioBlock *block) {
+    xQueueSend(free_blocks_, &block, 0);
+}
+
+FetapAudioBlockSubscriber::FetapAudioBlockSubscriber(size_t queue_depth, DropPolicy policy) : policy_(policy), queue_depth_(queue_depth) {
+    queue_ = xQueueCreate(queue_depth, sizeof(FetapAudioBlock *));
+}
+
+FetapAudioBlock *FetapAudioBlockSubscriber::receive(TickType_t ticks_to_wait) {
+    FetapAudioBlock *block{nullptr};
+    if (xQueueReceive(queue_, &block, ticks_to_wait) != pdTRUE) {
+        return nullptr;
+    }
+    return block;
+}
+
+void FetapAudioBlockSubscriber::flush(void) {
+    FetapAudioBlock *block{nullptr};
+    while (xQueueReceive(queue_, &block, 0) == pdTRUE) {
+        block->release();
+    }
+}
+
+void FetapAudioBlockSubscriber::push(FetapAudioBlock *block) {
+    block->retain();
+    if (xQueueSend(queue_, &block, 0) == pdTRUE) {
+        return;
+    }
+
+    if (policy_ == DropPolicy::DROP_OLDEST) {
+        // The subscriber may have taken a block in the meantime, in which case
+        // there is nothing to drop and the second send succeeds anyway
+        FetapAudioBlock *oldest{nullptr};
+        if (xQueueReceive(queue_, &oldest, 0) == pdTRUE) {
+            oldest->release();
+            dropped_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (xQueueSend(queue_, &block, 0) == pdTRUE) {
+            return;
+        }
+    }
+
+    block->release();
+    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+}
+
+}
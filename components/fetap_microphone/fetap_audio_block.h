@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+namespace esphome {
+namespace fetap {
+
+class FetapAudioBlockPool;
+
+/*
+    A block of captured audio samples (mono, 16kHz, int16_t) that is shared between all subscribers
+    of the fetap microphone. The block is filled once by the capture path and returned to its pool
+    as soon as the last holder released it, which may happen from any task.
+*/
+class FetapAudioBlock {
+public:
+
+    /*
+        \returns    Pointer to the audio samples of the block
+    */
+    const int16_t *data(void) const { return samples_.get(); }
+
+    /*
+        \returns    Number of valid audio samples in the block
+    */
+    size_t size(void) const { return size_; }
+
+    /*
+        \returns    Sequence number of the block, consecutive blocks have consecutive numbers. Subscribers
+                    can use this to detect blocks that were dropped.
+    */
+    uint32_t get_sequence(void) const { return sequence_; }
+
+    /*
+        Takes an additional reference to the block
+    */
+    void retain(void) { references_.fetch_add(1, std::memory_order_relaxed); }
+
+    /*
+        Releases a reference to the block. The block returns to its pool when the last reference is released.
+    */
+    void release(void);
+
+protected:
+    friend class FetapAudioBlockPool;
+
+    std::unique_ptr<int16_t[]> samples_; /*!< Sample storage, also used as scratch space for raw 32 bit I2S data */
+    size_t size_{0}; /*!< Number of valid samples */
+    uint32_t sequence_{0}; /*!< Sequence number assigned by the capture path */
+    std::atomic<uint8_t> references_{0}; /*!< Number of holders of the block */
+    FetapAudioBlockPool *pool_{nullptr}; /*!< Pool the block returns to */
+};
+
+/*
+    Fixed pool of audio blocks. All blocks are allocated once, acquiring and returning blocks never allocates.
+*/
+class FetapAudioBlockPool {
+public:
+
+    /*
+        Allocates the blocks of the pool
+
+        \param  n_blocks    Number of blocks in the pool
+        \param  capacity    Number of int16_t samples each block can hold
+
+        \returns    True if the pool was allocated successfully
+    */
+    bool allocate(size_t n_blocks, size_t capacity);
+
+    /*
+        \returns    True if the pool has been allocated
+    */
+    bool is_allocated(void) const { return free_blocks_ != nullptr; }
+
+    /*
+        Takes a free block from the pool without waiting. The caller holds the only reference to the block.
+
+        \param  sequence    Sequence number assigned to the block
+
+        \returns    The block or nullptr if all blocks are in use (counted as pool exhaustion)
+    */
+    FetapAudioBlock *acquire(uint32_t sequence);
+
+    /*
+        Sets the number of valid samples of a block that was acquired from this pool
+
+        \param  block   The block
+        \param  size    Number of valid samples
+    */
+    void set_size(FetapAudioBlock *block, size_t size) { block->size_ = size; }
+
+    /*
+        \returns    Pointer to the writable sample storage of a block that was acquired from this pool
+    */
+    int16_t *get_storage(FetapAudioBlock *block) { return block->samples_.get(); }
+
+    /*
+        \returns    Number of times a block was requested while all blocks were in use
+    */
+    uint32_t get_exhausted_count(void) const { return exhausted_count_.load(std::memory_order_relaxed); }
+
+protected:
+    friend class FetapAudioBlock;
+
+    /*
+        Returns a block without references to the pool
+
+        \param  block   The block to return
+    */
+    void recycle_(FetapAudioBlock *block);
+
+    std::unique_ptr<FetapAudioBlock[]> blocks_; /*!< Storage of all blocks */
+    QueueHandle_t free_blocks_{nullptr}; /*!< Queue of pointers to the blocks that are not in use */
+    std::atomic<uint32_t> exhausted_count_{0}; /*!< Number of failed acquire calls */
+};
+
+/*
+    Receives audio blocks from the fetap microphone through its own bounded queue while it is active.
+    Each subscriber consumes blocks at its own pace from any task, if it falls behind, blocks are dropped
+    for this subscriber only according to its drop policy. Active subscribers keep the microphone capturing,
+    so components that only need the audio blocks never start or stop the microphone themselves.
+*/
+class FetapAudioBlockSubscriber {
+public:
+
+    /*
+        What to drop when a new block arrives while the queue of the subscriber is full
+    */
+    enum class DropPolicy : uint8_t {
+        DROP_NEWEST, /*!< keep the queued blocks and drop the new block */
+        DROP_OLDEST, /*!< drop the oldest queued block to make room for the new block */
+    };
+
+    /*
+        \param  queue_depth     Maximum number of blocks held by the subscriber
+        \param  policy          What to drop when the subscriber falls behind
+    */
+    FetapAudioBlockSubscriber(size_t queue_depth, DropPolicy policy);
+
+    /*
+        \returns    Maximum number of blocks the subscriber holds at the same time: a full queue plus the
+                    block it is currently processing
+    */
+    size_t get_max_held_blocks(void) const { return queue_depth_ + 1; }
+
+    /*
+        Starts or stops receiving blocks. The microphone captures as long as any subscriber is active or
+        it was started through the microphone interface, e.g. by the voice assistant.
+
+        \param  active  True to receive blocks
+    */
+    void set_active(bool active) { active_.store(active, std::memory_order_relaxed); }
+
+    /*
+        \returns    True if the subscriber receives blocks
+    */
+    bool is_active(void) const { return active_.load(std::memory_order_relaxed); }
+
+    /*
+        Waits for the next block. The subscriber owns a reference to the returned block and has to
+        call release() on it as soon as the samples are no longer needed.
+
+        \param  ticks_to_wait   Maximum number of ticks to wait for a block
+
+        \returns    The next block or nullptr on timeout
+    */
+    FetapAudioBlock *receive(TickType_t ticks_to_wait);
+
+    /*
+        Releases all queued blocks, e.g. when the subscriber stops consuming
+    */
+    void flush(void);
+
+    /*
+        \returns    Number of blocks dropped for this subscriber
+    */
+    uint32_t get_dropped_count(void) const { return dropped_count_.load(std::memory_order_relaxed); }
+
+    /*
+        Called by the capture path to hand a block to the subscriber. Takes its own reference to the block.
+
+        \param  block   The captured block
+    */
+    void push(FetapAudioBlock *block);
+
+protected:
+    QueueHandle_t queue_{nullptr}; /*!< Queue of pointers to the blocks held by the subscriber */
+    DropPolicy policy_; /*!< What to drop when the queue is full */
+    size_t queue_depth_; /*!< Maximum number of queued blocks */
+    std::atomic<uint32_t> dropped_count_{0}; /*!< Number of dropped blocks */
+    std::atomic<bool> active_{false}; /*!< True while the subscriber receives blocks */
+};
+
+}
+}
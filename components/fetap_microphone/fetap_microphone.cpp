@@ -1,6 +1,11 @@
 #include "fetap_microphone.h"
 
+#include <algorithm>
+
+#include <esp_timer.h>
+
 #include "freertos/FreeRTOS.h"
+#include "esphome/core/hal.h"
 #include "esphome/core/log.h"
 
 namespace esphome {
@@ -12,6 +17,42 @@ static const char *const TAG = "fetap.microphone";
 void FetapMicrophone::setup(void) {
     esp_err_t err;
 
+    buffer_.reserve(kBufferSize);
+    raw_i2s_buffer_.reserve(kBufferSize);
+
+    if (!block_subscribers_.empty()) {
+        // Each subscriber holds at most its full queue plus the block it is processing and the capture
+        // path holds one more. With that many blocks the pool cannot run empty, so a slow subscriber
+        // only drops blocks from its own queue and the other subscribers keep receiving every block.
+        size_t n_blocks{1};
+        for (FetapAudioBlockSubscriber *subscriber : block_subscribers_) {
+            n_blocks += subscriber->get_max_held_blocks();
+        }
+        n_blocks = std::max(n_blocks, static_cast<size_t>(block_pool_size_));
+        if (!block_pool_.allocate(n_blocks, kBufferSize)) {
+            ESP_LOGE(TAG, "Error allocating audio block pool of %u blocks", static_cast<unsigned>(n_blocks));
+            mark_failed();
+            status_set_error();
+            return;
+        }
+    }
+
+#ifdef USE_FETAP_I2S
+    if (parent_ != nullptr) {
+        // The channel pair is created, configured and enabled by the fetap I2S component
+        i2s_rx_channel_ = parent_->get_rx_channel();
+        if (i2s_rx_channel_ == nullptr) {
+            ESP_LOGW(TAG, "Shared I2S channel pair is not available");
+            mark_failed();
+            status_set_error();
+            return;
+        }
+        shared_channel_ = true;
+        ESP_LOGI(TAG, "Fetap Microphone initialized successfully on shared I2S channel pair.");
+        return;
+    }
+#endif
+
     i2s_chan_config_t rx_chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
     err = i2s_new_channel(&rx_chan_cfg, NULL, &i2s_rx_channel_);
     if (err != ESP_OK) {
@@ -47,12 +88,19 @@ void FetapMicrophone::setup(void) {
         return;
     }
 
-    buffer_.reserve(kBufferSize);
-    raw_i2s_buffer_.reserve(kBufferSize);
-
     ESP_LOGI(TAG, "Fetap Microphone initialized successfully.");
 }
 
+bool FetapMicrophone::add_block_subscriber(FetapAudioBlockSubscriber *subscriber) {
+    if (block_pool_.is_allocated()) {
+        ESP_LOGE(TAG, "Block subscribers have to be added before setup");
+        return false;
+    }
+
+    block_subscribers_.push_back(subscriber);
+    return true;
+}
+
 void FetapMicrophone::start(void) {
     if (state_ == microphone::STATE_RUNNING || is_failed()) {
         return;
@@ -62,19 +110,43 @@ void FetapMicrophone::start(void) {
 }
 
 void FetapMicrophone::start_(void) {
-    const esp_err_t err = i2s_channel_enable(i2s_rx_channel_);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Error enabling I2S channel: %s", esp_err_to_name(err));
-        status_set_error();
+    // Active block subscribers may already keep the channel capturing
+    if (!enable_capture_()) {
         return;
     }
 
     state_ = microphone::STATE_RUNNING;
-    high_freq_.start();
     status_clear_error();
     ESP_LOGI(TAG, "Fetap Microphone started successfully.");
 }
 
+bool FetapMicrophone::enable_capture_(void) {
+    if (capturing_) {
+        return true;
+    }
+
+    if (shared_channel_) {
+        // The shared RX channel keeps running while the microphone is stopped. Drop the
+        // DMA buffers that were captured in the meantime so the first read is current.
+        size_t n_bytes_read{0};
+        do {
+            n_bytes_read = 0;
+            i2s_channel_read(i2s_rx_channel_, buffer_.data(), kBufferSize * sizeof(int16_t), &n_bytes_read, 0);
+        } while (n_bytes_read > 0);
+    } else {
+        const esp_err_t err = i2s_channel_enable(i2s_rx_channel_);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Error enabling I2S channel: %s", esp_err_to_name(err));
+            status_set_error();
+            return false;
+        }
+    }
+
+    capturing_ = true;
+    high_freq_.start();
+    return true;
+}
+
 void FetapMicrophone::stop(void) {
     if (state_ == microphone::STATE_STOPPED || is_failed()) {
         return;
@@ -89,19 +161,75 @@ void FetapMicrophone::stop(void) {
 }
 
 void FetapMicrophone::stop_(void) {
-    const esp_err_t err = i2s_channel_disable(i2s_rx_channel_);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Error disabling I2S channel: %s", esp_err_to_name(err));
-        status_set_error();
-        return;
+    // Active block subscribers keep the channel capturing, only the data callbacks stop
+    if (!has_active_subscriber_()) {
+        disable_capture_();
+        if (capturing_) {
+            return;
+        }
     }
 
     state_ = microphone::STATE_STOPPED;
-    high_freq_.stop();
+    discard_replay_();
     status_clear_error();
     ESP_LOGI(TAG, "Fetap Microphone stopped successfully.");
 }
 
+void FetapMicrophone::disable_capture_(void) {
+    if (!capturing_) {
+        return;
+    }
+
+    // The shared RX channel is never disabled to keep it aligned with the TX channel
+    if (!shared_channel_) {
+        const esp_err_t err = i2s_channel_disable(i2s_rx_channel_);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Error disabling I2S channel: %s", esp_err_to_name(err));
+            status_set_error();
+            return;
+        }
+    }
+
+    capturing_ = false;
+    high_freq_.stop();
+}
+
+bool FetapMicrophone::has_active_subscriber_(void) const {
+    for (const FetapAudioBlockSubscriber *subscriber : block_subscribers_) {
+        if (subscriber->is_active()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FetapMicrophone::replay(const int16_t *samples, size_t n_samples) {
+    if (n_samples == 0) {
+        return;
+    }
+
+    replay_samples_ = samples;
+    replay_remaining_ = n_samples;
+    replay_start_ms_ = millis();
+}
+
+void FetapMicrophone::replay_chunk_(void) {
+    const size_t n_chunk = std::min(replay_remaining_, kReplayChunkSamples);
+    buffer_.assign(replay_samples_, replay_samples_ + n_chunk);
+    data_callbacks_.call(buffer_);
+
+    replay_samples_ += n_chunk;
+    replay_remaining_ -= n_chunk;
+    if (replay_remaining_ == 0) {
+        discard_replay_();
+    }
+}
+
+void FetapMicrophone::discard_replay_(void) {
+    replay_samples_ = nullptr;
+    replay_remaining_ = 0;
+}
+
 size_t FetapMicrophone::read(int16_t *buf, size_t len) {
     size_t n_bytes_read{0};
 
@@ -122,34 +250,95 @@ size_t FetapMicrophone::read(int16_t *buf, size_t len) {
 
     status_clear_warning();
 
-    // Convert 32 bit samples to 16 bit samples
     const size_t samples_read = n_bytes_read / sizeof(int32_t);
+
+#ifdef USE_FETAP_TRACE
+    if (trace_ != nullptr) {
+        trace_->record_audio_block(esp_timer_get_time(), reinterpret_cast<int32_t *>(buf), samples_read);
+    }
+#endif
+
+    // Convert 32 bit samples to 16 bit samples, running the configured processing
+    // stages on the way. The chain is inlined, so this stays a single loop.
     for (size_t i = 0; i < samples_read; i++) {
-        int32_t temp = reinterpret_cast<int32_t *>(buf)[i] >> 13;
-        buf[i] = clamp<int16_t>(temp, INT16_MIN, INT16_MAX);
+        buf[i] = dsp::process_microphone_sample(dsp_chain_, reinterpret_cast<int32_t *>(buf)[i]);
     }
     return samples_read * sizeof(int16_t);
 }
 
 void FetapMicrophone::read_(void) {
-    // Note: In order to adhere to the esphome i2s_audio_microphone implementation,
-    //       we actually pass the amount of int32 samples that can be read into the
-    //       buffer_ (allocated as kBufferSize * sizeof(int16_t)).
-    const size_t bytes_read = read(buffer_.data(), kBufferSize / sizeof(int16_t));
+    const bool running = state_ == microphone::STATE_RUNNING;
 
-    buffer_.resize(bytes_read / sizeof(int16_t));
-    data_callbacks_.call(buffer_);
+    // Without active block subscribers, or if all blocks are still held by subscribers,
+    // capture into the local buffer so the data callbacks keep receiving audio.
+    FetapAudioBlock *block{nullptr};
+    if (has_active_subscriber_()) {
+        block = block_pool_.acquire(block_sequence_++);
+    }
+
+    if (block == nullptr) {
+        if (!running) {
+            return;
+        }
+
+        // Note: In order to adhere to the esphome i2s_audio_microphone implementation,
+        //       we actually pass the amount of int32 samples that can be read into the
+        //       buffer_ (allocated as kBufferSize * sizeof(int16_t)).
+        const size_t bytes_read = read(buffer_.data(), kBufferSize / sizeof(int16_t));
+
+        buffer_.resize(bytes_read / sizeof(int16_t));
+        data_callbacks_.call(buffer_);
+        return;
+    }
+
+    // The block is filled once and shared by reference with all subscribers
+    const size_t bytes_read = read(block_pool_.get_storage(block), kBufferSize / sizeof(int16_t));
+    block_pool_.set_size(block, bytes_read / sizeof(int16_t));
+    publish_block_(block);
+    block->release();
+}
+
+void FetapMicrophone::publish_block_(FetapAudioBlock *block) {
+    if (block->size() == 0) {
+        return;
+    }
+
+    for (FetapAudioBlockSubscriber *subscriber : block_subscribers_) {
+        if (subscriber->is_active()) {
+            subscriber->push(block);
+        }
+    }
+
+    // While the microphone interface is stopped, only the block subscribers receive audio
+    if (state_ == microphone::STATE_RUNNING && data_callbacks_.size() > 0) {
+        buffer_.assign(block->data(), block->data() + block->size());
+        data_callbacks_.call(buffer_);
+    }
 }
 
 void FetapMicrophone::loop(void) {
+    const bool subscribed = has_active_subscriber_();
+
     switch (state_) {
         case microphone::STATE_STOPPED:
+            if (replay_samples_ != nullptr && millis() - replay_start_ms_ > kReplayTimeoutMilliseconds) {
+                ESP_LOGD(TAG, "Microphone was not started in time, discarding replay audio");
+                discard_replay_();
+            }
+            if (!subscribed) {
+                disable_capture_();
+            } else if (enable_capture_()) {
+                read_();
+            }
             break;
         case microphone::STATE_STARTING:
             start_();
             break;
         case microphone::STATE_RUNNING:
-            if (data_callbacks_.size() > 0) {
+            if (replay_samples_ != nullptr) {
+                // The replay audio precedes the live audio, which waits in the DMA buffers
+                replay_chunk_();
+            } else if (data_callbacks_.size() > 0 || subscribed) {
                 read_();
             }
             break;
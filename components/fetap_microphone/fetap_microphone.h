@@ -5,12 +5,30 @@
 
 #include "esphome/components/microphone/microphone.h"
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
+
+#include "../fetap_dsp/fetap_dsp.h"
+#include "fetap_audio_block.h"
+
+#ifdef USE_FETAP_I2S
+#include "../fetap_i2s/fetap_i2s.h"
+#endif
+
+#ifdef USE_FETAP_TRACE
+#include "../fetap_trace/fetap_trace.h"
+#endif
+
+// Processing chain generated from the processing list of the microphone config
+#ifndef FETAP_MICROPHONE_DSP_CHAIN
+#define FETAP_MICROPHONE_DSP_CHAIN esphome::fetap::dsp::Chain<>
+#endif
 
 namespace esphome {
 namespace fetap {
 
 /*
     The fetap microphone class implements a basic I2S microphone component based on the new I2S driver.
+    It either owns a separate RX channel or uses the RX half of a fetap I2S full-duplex channel pair.
 */
 class FetapMicrophone : public microphone::Microphone, public Component {
 public:
@@ -23,7 +41,8 @@ public:
     void setup(void) override;
 
     /*
-        Called repeatedly, implements a rudimentary state machine
+        Called repeatedly, implements a rudimentary state machine. While the microphone is stopped, it keeps
+        capturing for active block subscribers.
     */
     void loop(void) override;
 
@@ -49,6 +68,43 @@ public:
     */
     size_t read(int16_t *buf, size_t len) override;
 
+    /* --------------------------- Functions used by other components --------------------------- */
+
+    /*
+        Registers a subscriber that receives every captured audio block without copying it. Unlike data
+        callbacks, subscribers consume the blocks asynchronously from their own task. The block pool is
+        sized for all subscribers during setup, so subscribers have to be added before, i.e. from code
+        generation.
+
+        \param  subscriber  The subscriber, has to outlive the microphone
+
+        \returns    False if the block pool was already allocated
+    */
+    bool add_block_subscriber(FetapAudioBlockSubscriber *subscriber);
+
+    /*
+        \returns    Number of captured blocks that could not be handed to the subscribers because all
+                    blocks of the pool were still held by subscribers. The pool is sized so that this
+                    stays 0.
+    */
+    uint32_t get_block_pool_exhausted_count(void) const { return block_pool_.get_exhausted_count(); }
+
+    /*
+        Hands audio that was captured for a block subscriber over to the data callbacks, e.g. an utterance
+        that a local recognizer passes on to the voice assistant. The next time the microphone runs, the
+        data callbacks receive this audio first, followed by the live audio. The audio is discarded if the
+        microphone is not started within kReplayTimeoutMilliseconds. Must be called from the main loop.
+
+        \param  samples     The audio samples, have to stay valid as long as is_replaying() returns true
+        \param  n_samples   Number of samples
+    */
+    void replay(const int16_t *samples, size_t n_samples);
+
+    /*
+        \returns    True while audio passed to replay() was not completely handed to the data callbacks
+    */
+    bool is_replaying(void) const { return replay_samples_ != nullptr; }
+
     /* --------------------------- Functions triggered from code generation --------------------------- */
     
     /*
@@ -72,6 +128,31 @@ public:
     */
     void set_lrclk_pin(int pin) { lrclk_pin_ = static_cast<gpio_num_t>(pin); }
 
+    /*
+        Sets the minimum number of audio blocks shared between the block subscribers
+
+        \param  size    Minimum number of blocks in the pool
+    */
+    void set_block_pool_size(int size) { block_pool_size_ = static_cast<uint8_t>(size); }
+
+#ifdef USE_FETAP_I2S
+    /*
+        Uses the RX channel of the given full-duplex channel pair instead of creating a separate one
+
+        \param  parent  The fetap I2S component that owns the channel pair
+    */
+    void set_parent(FetapI2S *parent) { parent_ = parent; }
+#endif
+
+#ifdef USE_FETAP_TRACE
+    /*
+        Records every raw I2S block into the given trace
+
+        \param  trace   The trace recorder
+    */
+    void set_trace(FetapTrace *trace) { trace_ = trace; }
+#endif
+
 private:
     static constexpr uint16_t kBufferSize{512}; /*!<    Number of int16 samples the buffer can hold. 
                                                         Since the same buffer is used for the raw i2s 
@@ -80,6 +161,37 @@ private:
                                                         int16 audio samples in a single call.*/
     
     static constexpr uint16_t kMaxI2SReadTimeoutMilliseconds{100}; /*!< Maximum timeout when reading from I2S peripheral */
+    static constexpr uint8_t kDefaultBlockPoolSize{4}; /*!< Default minimum number of blocks shared between the block subscribers */
+    static constexpr uint32_t kReplayTimeoutMilliseconds{2000}; /*!< Time to start the microphone before replay audio is discarded */
+    static constexpr size_t kReplayChunkSamples{kBufferSize}; /*!< Replay samples handed to the data callbacks per loop, the
+                                                                   live audio waits in the I2S DMA buffers meanwhile */
+
+    /*
+        Enables the I2S channel if it is not capturing yet
+
+        \returns    True if the channel is capturing
+    */
+    bool enable_capture_(void);
+
+    /*
+        Disables the I2S channel if it is capturing
+    */
+    void disable_capture_(void);
+
+    /*
+        \returns    True if any block subscriber is active
+    */
+    bool has_active_subscriber_(void) const;
+
+    /*
+        Hands the next chunk of the replay audio to the data callbacks
+    */
+    void replay_chunk_(void);
+
+    /*
+        Discards the remaining replay audio
+    */
+    void discard_replay_(void);
 
     /*
         Starts the I2S peripheral
@@ -96,12 +208,35 @@ private:
     */
     void read_(void);
 
+    /*
+        Hands the samples of the given block to the data callbacks and block subscribers
+
+        \param  block   The captured block, the caller keeps its reference
+    */
+    void publish_block_(FetapAudioBlock *block);
+
+    FETAP_MICROPHONE_DSP_CHAIN dsp_chain_; /*!< Processing stages applied to each sample before converting it to 16 bit */
     std::vector<int16_t> buffer_; /*!< Buffer for processed audio data */
     std::vector<uint32_t> raw_i2s_buffer_; /*!< Buffer for raw audio data */
+    FetapAudioBlockPool block_pool_; /*!< Blocks shared between the block subscribers */
+    std::vector<FetapAudioBlockSubscriber *> block_subscribers_; /*!< Registered block subscribers */
+    uint32_t block_sequence_{0}; /*!< Sequence number of the next captured block */
+    uint8_t block_pool_size_{kDefaultBlockPoolSize}; /*!< Minimum number of blocks in the pool */
     gpio_num_t din_pin_{I2S_GPIO_UNUSED}; /*!< DIN pin of I2S bus */
     gpio_num_t bclk_pin_{I2S_GPIO_UNUSED}; /*!< BCLK pin of the I2S bus */
     gpio_num_t lrclk_pin_{I2S_GPIO_UNUSED}; /*!< LRCLK/WS pin of the I2S bus */
     i2s_chan_handle_t i2s_rx_channel_; /*!< Channel handle of I2S peripheral */
+    bool shared_channel_{false}; /*!< True if the channel is owned by a fetap I2S full-duplex channel pair */
+    bool capturing_{false}; /*!< True while the I2S channel is enabled */
+    const int16_t *replay_samples_{nullptr}; /*!< Remaining audio to hand to the data callbacks before the live audio */
+    size_t replay_remaining_{0}; /*!< Number of remaining replay samples */
+    uint32_t replay_start_ms_{0}; /*!< Time at which replay() was called */
+#ifdef USE_FETAP_I2S
+    FetapI2S *parent_{nullptr}; /*!< Owner of the full-duplex channel pair, if used */
+#endif
+#ifdef USE_FETAP_TRACE
+    FetapTrace *trace_{nullptr}; /*!< Trace recorder for raw I2S blocks, if used */
+#endif
     HighFrequencyLoopRequester high_freq_; /*!< Speed up frequency at which loop is called */
 };
 
@@ -1,6 +1,6 @@
 from esphome import pins
 import esphome.codegen as cg
-from esphome.components import microphone
+from esphome.components import fetap_dsp, microphone
 import esphome.config_validation as cv
 from esphome.const import (
     CONF_ID,
@@ -8,24 +8,56 @@ from esphome.const import (
 )
 
 # DEPENDENCIES = ["microphone"]
+AUTO_LOAD = ["fetap_dsp"]
 
 CONF_I2S_LRCLK_PIN = "i2s_lrclk_pin"
 CONF_I2S_BCLK_PIN = "i2s_bclk_pin"
 CONF_I2S_DIN_PIN = "i2s_din_pin"
+CONF_FETAP_I2S_ID = "fetap_i2s_id"
+CONF_BLOCK_POOL_SIZE = "block_pool_size"
+CONF_FETAP_TRACE_ID = "fetap_trace_id"
 
 fetap_ns = cg.esphome_ns.namespace("fetap")
 FetapMicrophone = fetap_ns.class_(
     "FetapMicrophone", microphone.Microphone, cg.Component
     )
+FetapI2S = fetap_ns.class_("FetapI2S", cg.Component)
+FetapTrace = fetap_ns.class_("FetapTrace", cg.Component)
 
-CONFIG_SCHEMA = cv.Schema(
-    {
-        cv.GenerateID(): cv.declare_id(FetapMicrophone),
-        cv.Required(CONF_I2S_LRCLK_PIN): pins.internal_gpio_output_pin_number,
-        cv.Required(CONF_I2S_BCLK_PIN): pins.internal_gpio_output_pin_number,
-        cv.Required(CONF_I2S_DIN_PIN): pins.internal_gpio_output_pin_number,
-    }
-).extend(cv.COMPONENT_SCHEMA)
+I2S_PINS = [CONF_I2S_LRCLK_PIN, CONF_I2S_BCLK_PIN, CONF_I2S_DIN_PIN]
+
+
+def validate_i2s_bus(config):
+    # Either the microphone owns its own RX channel (pins given) or it uses
+    # the RX half of a fetap_i2s full-duplex channel pair (pins given there)
+    if CONF_FETAP_I2S_ID in config:
+        for pin in I2S_PINS:
+            if pin in config:
+                raise cv.Invalid(
+                    f"{pin} must be configured on the fetap_i2s component when {CONF_FETAP_I2S_ID} is used"
+                )
+    else:
+        for pin in I2S_PINS:
+            if pin not in config:
+                raise cv.Invalid(f"{pin} is required when {CONF_FETAP_I2S_ID} is not used")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.declare_id(FetapMicrophone),
+            cv.Optional(CONF_FETAP_I2S_ID): cv.use_id(FetapI2S),
+            cv.Optional(CONF_FETAP_TRACE_ID): cv.use_id(FetapTrace),
+            cv.Optional(CONF_BLOCK_POOL_SIZE, default=4): cv.int_range(min=1, max=32),
+            cv.Optional(fetap_dsp.CONF_PROCESSING, default=[]): fetap_dsp.PROCESSING_SCHEMA,
+            cv.Optional(CONF_I2S_LRCLK_PIN): pins.internal_gpio_output_pin_number,
+            cv.Optional(CONF_I2S_BCLK_PIN): pins.internal_gpio_output_pin_number,
+            cv.Optional(CONF_I2S_DIN_PIN): pins.internal_gpio_output_pin_number,
+        }
+    ).extend(cv.COMPONENT_SCHEMA),
+    validate_i2s_bus,
+)
 
 
 async def to_code(config):
@@ -33,6 +65,25 @@ async def to_code(config):
     await microphone.register_microphone(var, config)
     await cg.register_component(var, config)
 
-    cg.add(var.set_din_pin(config[CONF_I2S_DIN_PIN]))
-    cg.add(var.set_bclk_pin(config[CONF_I2S_BCLK_PIN]))
-    cg.add(var.set_lrclk_pin(config[CONF_I2S_LRCLK_PIN]))
\ No newline at end of file
+    cg.add(var.set_block_pool_size(config[CONF_BLOCK_POOL_SIZE]))
+
+    if CONF_FETAP_TRACE_ID in config:
+        trace = await cg.get_variable(config[CONF_FETAP_TRACE_ID])
+        cg.add(var.set_trace(trace))
+
+    if CONF_FETAP_I2S_ID in config:
+        parent = await cg.get_variable(config[CONF_FETAP_I2S_ID])
+        cg.add(var.set_parent(parent))
+    else:
+        cg.add(var.set_din_pin(config[CONF_I2S_DIN_PIN]))
+        cg.add(var.set_bclk_pin(config[CONF_I2S_BCLK_PIN]))
+        cg.add(var.set_lrclk_pin(config[CONF_I2S_LRCLK_PIN]))
+
+    # The processing stages are compiled into the sample loop, stages that are
+    # not listed do not exist in the binary. The define names a type, so it is
+    # emitted as a raw expression instead of a string literal.
+    if config[fetap_dsp.CONF_PROCESSING]:
+        cg.add_define(
+            "FETAP_MICROPHONE_DSP_CHAIN",
+            cg.RawExpression(fetap_dsp.chain_type(config[fetap_dsp.CONF_PROCESSING])),
+        )
@@ -0,0 +1,66 @@
+#include "fetap_mixer.h"
+
+#include <new>
+
+namespace esphome {
+
+namespace fetap {
+
+bool FetapMixerInput::allocate(size_t capacity) {
+    samples_.reset(new (std::nothrow) int16_t[capacity]);
+    space_ = xSemaphoreCreateBinary();
+    if (samples_ == nullptr || space_ == nullptr) {
+        return false;
+    }
+    mask_ = capacity - 1;
+    return true;
+}
+
+size_t FetapMixerInput::write(const void *samples, size_t n_samples, TickType_t ticks_to_wait) {
+    if (samples_ == nullptr) {
+        return 0;
+    }
+
+    const uint8_t *data = static_cast<const uint8_t *>(samples);
+    const TickType_t start = xTaskGetTickCount();
+    size_t n_written{0};
+
+    while (true) {
+        // Only the producer changes head_, so it can be read without synchronization
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t free = mask_ + 1 - (head - tail_.load(std::memory_order_acquire));
+        const size_t n_chunk = free < n_samples - n_written ? free : n_samples - n_written;
+
+        if (n_chunk > 0) {
+            // At most two copies, before and after the wrap-around of the ring buffer
+            const size_t index = head & mask_;
+            const size_t n_first = n_chunk < mask_ + 1 - index ? n_chunk : mask_ + 1 - index;
+            memcpy(samples_.get() + index, data + n_written * sizeof(int16_t), n_first * sizeof(int16_t));
+            memcpy(samples_.get(), data + (n_written + n_first) * sizeof(int16_t), (n_chunk - n_first) * sizeof(int16_t));
+            head_.store(head + n_chunk, std::memory_order_release);
+            n_written += n_chunk;
+            if (mixer_ != nullptr) {
+                mixer_->notify_();
+            }
+        }
+
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if (n_written == n_samples || elapsed >= ticks_to_wait) {
+            return n_written;
+        }
+        xSemaphoreTake(space_, ticks_to_wait - elapsed);
+    }
+}
+
+bool FetapMixer::add_input(FetapMixerInput *input) {
+    if (n_inputs_ >= kMaxInputs) {
+        return false;
+    }
+    input->mixer_ = this;
+    inputs_[n_inputs_++] = input;
+    return true;
+}
+
+}
+
+}
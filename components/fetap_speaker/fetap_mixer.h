@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+namespace esphome {
+namespace fetap {
+
+class FetapMixer;
+
+/*
+    An input slot of the fetap mixer. A single producer writes mono 16kHz int16_t samples into the
+    lock-free ring buffer of the slot, the mixer task reads them in place while mixing.
+*/
+class FetapMixerInput {
+public:
+    static constexpr int32_t kUnityGainQ12{1 << 12}; /*!< Gain of 1.0 in Q12 */
+
+    /*
+        Allocates the ring buffer
+
+        \param  capacity    Number of samples the ring buffer can hold, has to be a power of two
+
+        \returns    True if the ring buffer was allocated successfully
+    */
+    bool allocate(size_t capacity);
+
+    /*
+        Copies samples into the ring buffer, waits for free space if necessary. Must only be called
+        from one task at a time. Nothing is written before the ring buffer was allocated.
+
+        \param  samples         The samples (int16_t, may be unaligned)
+        \param  n_samples       Number of samples
+        \param  ticks_to_wait   Maximum number of ticks to wait for free space
+
+        \returns    Number of samples written
+    */
+    size_t write(const void *samples, size_t n_samples, TickType_t ticks_to_wait);
+
+    /*
+        Discards all buffered samples. The mixer drops them before it mixes the next frame.
+    */
+    void clear(void) { clear_requested_.store(true, std::memory_order_release); }
+
+    /*
+        \returns    True if samples are buffered and not yet mixed
+    */
+    bool has_data(void) const {
+        return !clear_requested_.load(std::memory_order_acquire) &&
+               head_.load(std::memory_order_acquire) != tail_.load(std::memory_order_acquire);
+    }
+
+    /*
+        Sets the gain of the slot
+
+        \param  gain_q12    The gain in Q12
+    */
+    void set_gain(int32_t gain_q12) { gain_q12_ = gain_q12; }
+
+    /*
+        Sets the priority of the slot. While a slot with higher priority plays, the slot is ducked.
+
+        \param  priority    The priority, higher values win
+    */
+    void set_priority(uint8_t priority) { priority_ = priority; }
+
+protected:
+    friend class FetapMixer;
+
+    std::unique_ptr<int16_t[]> samples_; /*!< Ring buffer storage */
+    size_t mask_{0}; /*!< Capacity of the ring buffer minus one */
+    std::atomic<size_t> head_{0}; /*!< Number of samples written, only changed by the producer */
+    std::atomic<size_t> tail_{0}; /*!< Number of samples mixed, only changed by the mixer */
+    std::atomic<bool> clear_requested_{false}; /*!< True if the buffered samples should be discarded */
+    SemaphoreHandle_t space_{nullptr}; /*!< Given by the mixer after it consumed samples */
+    FetapMixer *mixer_{nullptr}; /*!< Mixer that reads the slot */
+    int32_t gain_q12_{kUnityGainQ12}; /*!< Configured gain in Q12 */
+    int32_t current_gain_q20_{kUnityGainQ12 << 8}; /*!< Gain applied to the last mixed sample of the slot in Q20 */
+    uint8_t priority_{0}; /*!< Ducking priority */
+    bool playing_{false}; /*!< True while the slot has data or ran empty less than kDuckHoldMilliseconds ago */
+    TickType_t last_data_ticks_{0}; /*!< Tick count of the last mix that found data in the slot */
+};
+
+/*
+    Mixes the input slots into one output stream. Each call mixes one DMA frame in a single pass over the
+    output samples: the samples are read in place from the ring buffers of the slots, scaled, summed and
+    saturated to int16_t before they are handed to the output functor. Slots with a lower priority than
+    the highest playing slot are ducked, gain changes are ramped over the samples of one frame to avoid
+    clicks.
+*/
+class FetapMixer {
+public:
+    static constexpr size_t kMaxInputs{8}; /*!< Maximum number of input slots */
+    static constexpr uint32_t kDuckHoldMilliseconds{150}; /*!< Time a slot keeps ducking after it ran empty, bridges short stream gaps */
+
+    /*
+        Adds an input slot
+
+        \param  input   The slot, has to outlive the mixer
+
+        \returns    False if the maximum number of slots is reached
+    */
+    bool add_input(FetapMixerInput *input);
+
+    /*
+        Sets the gain that is applied to slots while they are ducked
+
+        \param  gain_q12    The gain in Q12
+    */
+    void set_duck_gain(int32_t gain_q12) { duck_gain_q12_ = gain_q12; }
+
+    /*
+        Sets the task that calls mix(), it is notified when samples are written into a slot
+
+        \param  task    The mixer task
+    */
+    void set_task(TaskHandle_t task) { task_ = task; }
+
+    /*
+        Waits until samples were written into any slot
+
+        \param  ticks_to_wait   Maximum number of ticks to wait
+    */
+    void wait_for_data(TickType_t ticks_to_wait) { ulTaskNotifyTake(pdTRUE, ticks_to_wait); }
+
+    /*
+        Mixes the next frame
+
+        \param  n_samples   Number of samples of the frame
+        \param  output      Called as output(index, sample) with each mixed sample in the int16_t range
+
+        \returns    n_samples, or 0 if all slots are empty (output is not called in this case)
+    */
+    template<typename F>
+    size_t mix(size_t n_samples, F &&output) {
+        size_t tail[kMaxInputs];
+        size_t contribution[kMaxInputs];
+        int32_t gain_q20[kMaxInputs];
+        int32_t step_q20[kMaxInputs];
+        int32_t target_q20[kMaxInputs];
+
+        // Determine how much each slot contributes and which priority currently plays. The hold is measured
+        // in ticks, the mixer task sleeps while all slots are empty, so no frames are mixed during a gap.
+        const TickType_t now_ticks = xTaskGetTickCount();
+        bool any_data{false};
+        bool any_playing{false};
+        uint8_t top_priority{0};
+        for (size_t k = 0; k < n_inputs_; k++) {
+            FetapMixerInput *input = inputs_[k];
+            if (input->clear_requested_.exchange(false, std::memory_order_acq_rel)) {
+                input->tail_.store(input->head_.load(std::memory_order_acquire), std::memory_order_release);
+                input->playing_ = false;
+            }
+            tail[k] = input->tail_.load(std::memory_order_relaxed);
+            const size_t available = input->head_.load(std::memory_order_acquire) - tail[k];
+            contribution[k] = available < n_samples ? available : n_samples;
+
+            if (available > 0) {
+                input->playing_ = true;
+                input->last_data_ticks_ = now_ticks;
+                any_data = true;
+            } else if (input->playing_ && now_ticks - input->last_data_ticks_ >= pdMS_TO_TICKS(kDuckHoldMilliseconds)) {
+                input->playing_ = false;
+            }
+            if (input->playing_ && (!any_playing || input->priority_ > top_priority)) {
+                top_priority = input->priority_;
+                any_playing = true;
+            }
+        }
+
+        if (!any_data) {
+            return 0;
+        }
+
+        for (size_t k = 0; k < n_inputs_; k++) {
+            FetapMixerInput *input = inputs_[k];
+            const int32_t target_q12 = input->priority_ < top_priority ? (input->gain_q12_ * duck_gain_q12_) >> 12 : input->gain_q12_;
+            target_q20[k] = target_q12 << 8;
+            gain_q20[k] = input->current_gain_q20_;
+            step_q20[k] = (target_q20[k] - gain_q20[k]) / static_cast<int32_t>(n_samples);
+        }
+
+        // The output is split into segments in which every contributing ring buffer is contiguous,
+        // i.e. at the wrap-around and at the end of the buffered samples of each slot
+        const int16_t *source[kMaxInputs];
+        uint8_t live[kMaxInputs];
+        size_t position{0};
+        while (position < n_samples) {
+            size_t end{n_samples};
+            size_t n_live{0};
+            for (size_t k = 0; k < n_inputs_; k++) {
+                if (position >= contribution[k]) {
+                    continue;
+                }
+                const FetapMixerInput *input = inputs_[k];
+                const size_t index = (tail[k] + position) & input->mask_;
+                const size_t contiguous = input->mask_ + 1 - index;
+                const size_t remaining = contribution[k] - position;
+                const size_t segment_end = position + (remaining < contiguous ? remaining : contiguous);
+                end = segment_end < end ? segment_end : end;
+                source[n_live] = input->samples_.get() + index;
+                live[n_live++] = static_cast<uint8_t>(k);
+            }
+
+            for (size_t i = position; i < end; i++) {
+                int32_t sum{0};
+                for (size_t l = 0; l < n_live; l++) {
+                    const uint8_t k = live[l];
+                    gain_q20[k] += step_q20[k];
+                    sum += (static_cast<int32_t>(*source[l]++) * (gain_q20[k] >> 8)) >> 12;
+                }
+                output(i, sum > INT16_MAX ? INT16_MAX : (sum < INT16_MIN ? INT16_MIN : sum));
+            }
+            position = end;
+        }
+
+        for (size_t k = 0; k < n_inputs_; k++) {
+            // The ramp only advances on contributed samples. A slot that ran empty within the frame
+            // continues from the gain it reached, a complete frame lands exactly on the target.
+            inputs_[k]->current_gain_q20_ = contribution[k] == n_samples ? target_q20[k] : gain_q20[k];
+            if (contribution[k] > 0) {
+                inputs_[k]->tail_.store(tail[k] + contribution[k], std::memory_order_release);
+                xSemaphoreGive(inputs_[k]->space_);
+            }
+        }
+        return n_samples;
+    }
+
+protected:
+    friend class FetapMixerInput;
+
+    /*
+        Wakes up the mixer task after samples were written into a slot
+    */
+    void notify_(void) {
+        if (task_ != nullptr) {
+            xTaskNotifyGive(task_);
+        }
+    }
+
+    FetapMixerInput *inputs_[kMaxInputs]; /*!< The input slots */
+    size_t n_inputs_{0}; /*!< Number of input slots */
+    int32_t duck_gain_q12_{FetapMixerInput::kUnityGainQ12 / 10}; /*!< Gain of ducked slots in Q12 */
+    TaskHandle_t task_{nullptr}; /*!< Task that calls mix() */
+};
+
+}
+}
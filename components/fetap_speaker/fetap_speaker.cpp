@@ -1,6 +1,7 @@
 #include "fetap_speaker.h"
 
 #include "freertos/FreeRTOS.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 
 namespace esphome {
@@ -9,44 +10,99 @@ namespace fetap {
 
 static const char *const TAG = "fetap.speaker";
 
+static const size_t TASK_STACK_SIZE = 4096;
+static const ssize_t TASK_PRIORITY = 19;
+
 void FetapSpeaker::setup(void) {
     esp_err_t err;
 
-    i2s_chan_config_t tx_chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
-    err = i2s_new_channel(&tx_chan_cfg, &i2s_tx_channel_, NULL);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Error creating I2S channel: %s", esp_err_to_name(err));
+    if (!input_.allocate(kInputBufferSamples) || !mixer_.add_input(&input_)) {
+        ESP_LOGE(TAG, "Error allocating mixer slot");
         mark_failed();
         status_set_error();
         return;
     }
-
-    i2s_std_config_t tx_std_cfg = {
-        .clk_cfg  = I2S_STD_CLK_DEFAULT_CONFIG(16000),
-        .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
-        .gpio_cfg = {
-            .mclk = I2S_GPIO_UNUSED,
-            .bclk = bclk_pin_,
-            .ws   = lrclk_pin_,
-            .dout = dout_pin_,
-            .din  = I2S_GPIO_UNUSED,
-            .invert_flags = {
-                .mclk_inv = false,
-                .bclk_inv = false,
-                .ws_inv   = false,
+    for (FetapSpeakerSource *source : sources_) {
+        if (!source->get_input()->allocate(kInputBufferSamples) || !mixer_.add_input(source->get_input())) {
+            ESP_LOGE(TAG, "Error allocating mixer slot");
+            mark_failed();
+            status_set_error();
+            return;
+        }
+    }
+    buffer_.resize(kMixFrameSamples);
+
+#ifdef USE_FETAP_I2S
+    if (parent_ != nullptr) {
+        // The channel pair is created, configured and enabled by the fetap I2S component
+        i2s_tx_channel_ = parent_->get_tx_channel();
+        if (i2s_tx_channel_ == nullptr) {
+            ESP_LOGW(TAG, "Shared I2S channel pair is not available");
+            mark_failed();
+            status_set_error();
+            return;
+        }
+        shared_channel_ = true;
+        wide_buffer_.resize(kMixFrameSamples);
+    }
+#endif
+
+    if (!shared_channel_) {
+        // The channel stays enabled and sends silence whenever the mixer has nothing to play,
+        // so sources can start at any time without waiting for the speaker state machine
+        i2s_chan_config_t tx_chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
+        tx_chan_cfg.auto_clear = true;
+        err = i2s_new_channel(&tx_chan_cfg, &i2s_tx_channel_, NULL);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Error creating I2S channel: %s", esp_err_to_name(err));
+            mark_failed();
+            status_set_error();
+            return;
+        }
+
+        i2s_std_config_t tx_std_cfg = {
+            .clk_cfg  = I2S_STD_CLK_DEFAULT_CONFIG(16000),
+            .slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+            .gpio_cfg = {
+                .mclk = I2S_GPIO_UNUSED,
+                .bclk = bclk_pin_,
+                .ws   = lrclk_pin_,
+                .dout = dout_pin_,
+                .din  = I2S_GPIO_UNUSED,
+                .invert_flags = {
+                    .mclk_inv = false,
+                    .bclk_inv = false,
+                    .ws_inv   = false,
+                },
             },
-        },
-    };
-    tx_std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
-    err = i2s_channel_init_std_mode(i2s_tx_channel_, &tx_std_cfg);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Error initializing I2S channel: %s", esp_err_to_name(err));
-        mark_failed();
-        status_set_error();
-        return;
+        };
+        tx_std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+        err = i2s_channel_init_std_mode(i2s_tx_channel_, &tx_std_cfg);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Error initializing I2S channel: %s", esp_err_to_name(err));
+            mark_failed();
+            status_set_error();
+            return;
+        }
+
+        err = i2s_channel_enable(i2s_tx_channel_);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Error enabling I2S channel: %s", esp_err_to_name(err));
+            mark_failed();
+            status_set_error();
+            return;
+        }
     }
 
-    ESP_LOGI(TAG, "Fetap Speaker initialized successfully.");
+    xTaskCreate(FetapSpeaker::speaker_task, "fetapspk_task", TASK_STACK_SIZE, (void *) this, TASK_PRIORITY,
+                &task_handle_);
+    mixer_.set_task(task_handle_);
+
+    ESP_LOGI(TAG, "Fetap Speaker initialized successfully%s.", shared_channel_ ? " on shared I2S channel pair" : "");
+}
+
+void FetapSpeaker::add_source(FetapSpeakerSource *source) {
+    sources_.push_back(source);
 }
 
 void FetapSpeaker::start(void) {
@@ -58,20 +114,14 @@ void FetapSpeaker::start(void) {
 }
 
 void FetapSpeaker::start_(void) {
-    const esp_err_t err = i2s_channel_enable(i2s_tx_channel_);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Error enabling I2S channel: %s", esp_err_to_name(err));
-        status_set_error();
-        return;
-    }
-
+    // The channel is always enabled, the mixer task picks up the audio as soon as it is queued
     state_ = State::RUNNING;
     status_clear_error();
     ESP_LOGI(TAG, "Fetap Speaker started successfully.");
 }
 
 void FetapSpeaker::stop(void) {
-    if (is_failed() || state_ != State::RUNNING) {
+    if (is_failed() || state_ == State::STOPPED || state_ == State::STOPPING) {
         return;
     }
 
@@ -84,12 +134,8 @@ void FetapSpeaker::stop(void) {
 }
 
 void FetapSpeaker::stop_(void) {
-    const esp_err_t err = i2s_channel_disable(i2s_tx_channel_);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Error disabling I2S channel: %s", esp_err_to_name(err));
-        status_set_error();
-        return;
-    }
+    // Only the audio of play() is discarded, the additional sources keep playing
+    input_.clear();
 
     state_ = State::STOPPED;
     status_clear_error();
@@ -97,20 +143,54 @@ void FetapSpeaker::stop_(void) {
 }
 
 size_t FetapSpeaker::write_(const uint8_t* const data, const size_t length, const TickType_t ticks_to_wait) {
-    const size_t n_samples = length / sizeof(int16_t);
-    buffer_.resize(n_samples);
-    memcpy(buffer_.data(), data, length);
-    for (size_t i = 0; i < n_samples; i++) {
-        buffer_.at(i) = buffer_.at(i) >> kAudioGainShift;
+    // Playing starts the speaker like the i2s_audio speaker does. Audio written while stopping would be
+    // discarded by stop_() anyway, so it is rejected until the speaker is stopped.
+    if (state_ == State::STOPPED) {
+        start();
+    }
+    if (state_ == State::STOPPING || is_failed()) {
+        return 0;
+    }
+
+    return input_.write(data, length / sizeof(int16_t), ticks_to_wait) * sizeof(int16_t);
+}
+
+void FetapSpeaker::speaker_task(void *params) {
+    FetapSpeaker *instance = static_cast<FetapSpeaker *>(params);
+
+    while (1) {
+        instance->task_loop_();
     }
+}
+
+void FetapSpeaker::task_loop_(void) {
+    size_t n_samples{0};
     size_t n_bytes_written{0};
-    const esp_err_t err = i2s_channel_write(i2s_tx_channel_, buffer_.data(), length, &n_bytes_written, ticks_to_wait);
+    esp_err_t err;
+
+    // Each mixed sample is converted and stored straight into the buffer handed to the I2S driver
+    if (shared_channel_) {
+        // The shared channel pair uses 32 bit slots, so the 16 bit samples are left-aligned in the slot
+        n_samples = mixer_.mix(kMixFrameSamples, [this](size_t i, int32_t sample) {
+            wide_buffer_[i] = static_cast<int32_t>(output_sample_(sample)) << 16;
+        });
+        if (n_samples == 0) {
+            mixer_.wait_for_data(portMAX_DELAY);
+            return;
+        }
+        err = i2s_channel_write(i2s_tx_channel_, wide_buffer_.data(), n_samples * sizeof(int32_t), &n_bytes_written, portMAX_DELAY);
+    } else {
+        n_samples = mixer_.mix(kMixFrameSamples, [this](size_t i, int32_t sample) { buffer_[i] = output_sample_(sample); });
+        if (n_samples == 0) {
+            mixer_.wait_for_data(portMAX_DELAY);
+            return;
+        }
+        err = i2s_channel_write(i2s_tx_channel_, buffer_.data(), n_samples * sizeof(int16_t), &n_bytes_written, portMAX_DELAY);
+    }
+
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Error writing to I2S channel: %s", esp_err_to_name(err));
-        status_set_warning();
     }
-
-    return n_bytes_written;
 }
 
 void FetapSpeaker::loop(void) {
@@ -131,5 +211,17 @@ void FetapSpeaker::loop(void) {
     }
 }
 
+void FetapSpeakerSource::stop(void) {
+    input_.clear();
+    state_ = speaker::STATE_STOPPED;
+}
+
+size_t FetapSpeakerSource::play(const uint8_t *data, size_t length, TickType_t ticks_to_wait) {
+    if (state_ != speaker::STATE_RUNNING) {
+        start();
+    }
+    return input_.write(data, length / sizeof(int16_t), ticks_to_wait) * sizeof(int16_t);
+}
+
 }
 }
\ No newline at end of file
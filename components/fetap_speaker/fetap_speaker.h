@@ -5,12 +5,31 @@
 
 #include "esphome/components/speaker/speaker.h"
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
+#include "esphome/core/helpers.h"
+
+#include "../fetap_dsp/fetap_dsp.h"
+#include "fetap_mixer.h"
+
+#ifdef USE_FETAP_I2S
+#include "../fetap_i2s/fetap_i2s.h"
+#endif
+
+// Processing chain generated from the processing list of the speaker config
+#ifndef FETAP_SPEAKER_DSP_CHAIN
+#define FETAP_SPEAKER_DSP_CHAIN esphome::fetap::dsp::Chain<>
+#endif
 
 namespace esphome {
 namespace fetap {
 
+class FetapSpeakerSource;
+
 /*
     The fetap speaker class implements a basic I2S speaker component based on the new I2S driver.
+    It either owns a separate TX channel or uses the TX half of a fetap I2S full-duplex channel pair.
+    Audio passed to play() and to the additional sources (see FetapSpeakerSource) is buffered in one
+    mixer slot each and mixed by the speaker task in front of the TX channel.
 */
 class FetapSpeaker : public speaker::Speaker, public Component {
 public:
@@ -40,43 +59,43 @@ public:
     /* --------------------------- Functions inherited from speaker interface --------------------------- */
 
     /*
-        Requests to start the I2S peripheral for the speaker
+        Requests to start the speaker. The I2S peripheral keeps running for the additional sources, the
+        state only decides whether play() accepts audio.
     */
     void start(void) override;
 
     /*
-        Request to stop the I2S peripheral for the speaker
+        Requests to stop the speaker, discards the audio passed to play() that has not been mixed yet.
+        The additional sources keep playing.
     */
     void stop(void) override;
 
     /*
-        The fetap speaker does not use a ring buffer and forwards all data straight to the I2S peripheral.
-        Hence, it never buffers data.
-
-        \returns    False, as the fetap speaker implementation does not buffer audio data.
+        \returns    True if audio passed to play() has not been mixed yet
     */
-    bool has_buffered_data() const override { return false; };
+    bool has_buffered_data() const override { return input_.has_data(); };
 
     /*
-        Plays the given audio data.
+        Queues the given audio data for playback. Starts the speaker if it is stopped, nothing is queued while
+        it is stopping.
 
         \param  data            Pointer to the audio data buffer to be played. The audio data format is mono channel, 16kHz sampling 
                                 rate and each sample is an int16_t (2 bytes per sample).
         \param  length          The number of bytes in the audio data buffer.
-        \param  ticks_to_wait   The maximum number of ticks (NOT milliseconds) to wait for the I2S audio data to be written.
+        \param  ticks_to_wait   The maximum number of ticks (NOT milliseconds) to wait for free space in the buffer.
 
-        \returns    The number of bytes that were successfully "played" (=written to the I2S peripheral).
+        \returns    The number of bytes that were successfully queued.
     */
     size_t play(const uint8_t *data, size_t length, TickType_t ticks_to_wait) override { return write_(data, length, ticks_to_wait); };
 
     /*
-        Plays the given audio data.
+        Queues the given audio data for playback.
 
         \param  data            Pointer to the audio data buffer to be played. The audio data format is mono channel, 16kHz sampling 
                                 rate and each sample is an int16_t (2 bytes per sample).
         \param  length          The number of bytes in the audio data buffer.
 
-        \returns    The number of bytes that were successfully "played" (=written to the I2S peripheral).
+        \returns    The number of bytes that were successfully queued.
     */
     size_t play(const uint8_t *data, size_t length) override { return write_(data, length); };
 
@@ -103,11 +122,43 @@ public:
     */
     void set_lrclk_pin(int pin) { lrclk_pin_ = static_cast<gpio_num_t>(pin); }
 
+    /*
+        Sets the ducking priority of the audio passed to play()
+
+        \param  priority    The priority, higher values win
+    */
+    void set_priority(int priority) { input_.set_priority(static_cast<uint8_t>(priority)); }
+
+    /*
+        Sets the gain applied to sources while a source with higher priority plays
+
+        \param  gain_q12    The gain in Q12
+    */
+    void set_duck_gain(int gain_q12) { mixer_.set_duck_gain(gain_q12); }
+
+    /*
+        Adds an additional source that is mixed with the audio passed to play()
+
+        \param  source  The source
+    */
+    void add_source(FetapSpeakerSource *source);
+
+#ifdef USE_FETAP_I2S
+    /*
+        Uses the TX channel of the given full-duplex channel pair instead of creating a separate one
+
+        \param  parent  The fetap I2S component that owns the channel pair
+    */
+    void set_parent(FetapI2S *parent) { parent_ = parent; }
+#endif
 
 private:
-    static constexpr uint16_t kMaxI2SDefaultWriteTimeoutTicks{100}; /*!< Default maximum timeout when writing to I2S peripheral */
+    static constexpr uint16_t kMaxI2SDefaultWriteTimeoutTicks{100}; /*!< Default maximum timeout when waiting for free buffer space */
+    static constexpr size_t kInputBufferSamples{4096}; /*!< Samples buffered per mixer slot (256 ms), a power of two */
+    static constexpr size_t kMixFrameSamples{240}; /*!< Samples mixed per pass, matches the DMA frame of the I2S driver */
     static constexpr uint8_t kAudioGainShift{4}; /*!<   Number of right shifts for audio samples to control loudness.
-                                                        The resulting gain factor is 1 / (2^kAudioGainShift) */
+                                                        The resulting gain factor is 1 / (2^kAudioGainShift) and is
+                                                        applied after the configured processing stages. */
 
     /*
         Starts the I2S peripheral
@@ -120,26 +171,122 @@ private:
     void stop_(void);
 
     /*
-        Writes the given data to the I2S peripheral.
+        Writes the given data into the mixer slot of play().
 
         \param  data            Pointer to the audio data buffer to be played. The audio data format is mono channel, 16kHz sampling 
                                 rate and each sample is an int16_t (2 bytes per sample).
         \param  length          The number of bytes in the audio data buffer.
-        \param  ticks_to_wait   The maximum number of ticks (NOT milliseconds) to wait for the I2S audio data to be written. Defaults
+        \param  ticks_to_wait   The maximum number of ticks (NOT milliseconds) to wait for free space in the buffer. Defaults
                                 to kMaxI2SDefaultWriteTimeoutTicks
 
-        \returns    The number of bytes that were successfully "played" (=written to the I2S peripheral).
+        \returns    The number of bytes that were successfully queued.
     */
     size_t write_(const uint8_t* const data, const size_t length, const TickType_t ticks_to_wait = kMaxI2SDefaultWriteTimeoutTicks);
 
+    /*
+        Function that is registered as a task to run asynchronously from main loop
+    */
+    static void speaker_task(void *params);
+
+    /*
+        Repeatedly called by the speaker task. Mixes the next frame and writes it to the I2S peripheral,
+        the blocking write paces the task to the sample rate. Sleeps while all slots are empty.
+    */
+    void task_loop_(void);
+
+    /*
+        Applies the processing stages and the output gain to a mixed sample
+
+        \param  sample  The mixed sample
+
+        \returns    The sample for the I2S peripheral
+    */
+    int16_t output_sample_(int32_t sample) {
+        return static_cast<int16_t>(clamp<int32_t>(dsp_chain_.process(sample) >> kAudioGainShift, INT16_MIN, INT16_MAX));
+    }
+
     gpio_num_t dout_pin_{I2S_GPIO_UNUSED}; /*!< DOUT pin of I2S bus */
     gpio_num_t bclk_pin_{I2S_GPIO_UNUSED}; /*!< BCLK pin of I2S bus */
     gpio_num_t lrclk_pin_{I2S_GPIO_UNUSED}; /*!< LRCLK/WS pin of I2S bus */
     i2s_chan_handle_t i2s_tx_channel_; /*!< Channel handle of I2S peripheral */
-    std::vector<int16_t> buffer_; /*!< Audio buffer used to manipulate audio before writing to I2S peripheral */
+    FETAP_SPEAKER_DSP_CHAIN dsp_chain_; /*!< Processing stages applied to each mixed sample before writing it to the I2S peripheral */
+    FetapMixer mixer_; /*!< Mixes the slots of play() and the additional sources */
+    FetapMixerInput input_; /*!< Mixer slot of play() */
+    std::vector<FetapSpeakerSource *> sources_; /*!< Additional sources */
+    TaskHandle_t task_handle_{nullptr}; /*!< Reference to the speaker task */
+    std::vector<int16_t> buffer_; /*!< Mixed audio written to the I2S peripheral */
+    std::vector<int32_t> wide_buffer_; /*!< Audio buffer holding 32 bit samples for the 32 bit slots of a shared channel pair */
+    bool shared_channel_{false}; /*!< True if the channel is owned by a fetap I2S full-duplex channel pair */
+#ifdef USE_FETAP_I2S
+    FetapI2S *parent_{nullptr}; /*!< Owner of the full-duplex channel pair, if used */
+#endif
     State state_{State::STOPPED}; /*!< Current state of the fetap speaker */
 };
 
+/*
+    An additional audio source of the fetap speaker, e.g. for confirmation beeps or local prompts. Each
+    source has its own mixer slot with its own gain and ducking priority, so it can play at the same time
+    as the audio passed to the fetap speaker itself.
+*/
+class FetapSpeakerSource : public speaker::Speaker {
+public:
+
+    /* --------------------------- Functions inherited from speaker interface --------------------------- */
+
+    /*
+        Marks the source as running
+    */
+    void start(void) override { state_ = speaker::STATE_RUNNING; }
+
+    /*
+        Discards the buffered audio of the source
+    */
+    void stop(void) override;
+
+    /*
+        \returns    True if audio of the source has not been mixed yet
+    */
+    bool has_buffered_data() const override { return input_.has_data(); };
+
+    /*
+        Queues the given audio data for playback, see FetapSpeaker::play()
+    */
+    size_t play(const uint8_t *data, size_t length, TickType_t ticks_to_wait) override;
+
+    /*
+        Queues the given audio data for playback, see FetapSpeaker::play()
+    */
+    size_t play(const uint8_t *data, size_t length) override { return play(data, length, kDefaultWriteTimeoutTicks); };
+
+    /* --------------------------- Functions triggered from code generation --------------------------- */
+
+    /*
+        Sets the ducking priority of the source
+
+        \param  priority    The priority, higher values win
+    */
+    void set_priority(int priority) { input_.set_priority(static_cast<uint8_t>(priority)); }
+
+    /*
+        Sets the gain of the source
+
+        \param  gain_q12    The gain in Q12
+    */
+    void set_gain(int gain_q12) { input_.set_gain(gain_q12); }
+
+    /* --------------------------- Functions used by the fetap speaker --------------------------- */
+
+    /*
+        \returns    The mixer slot of the source
+    */
+    FetapMixerInput *get_input(void) { return &input_; }
+
+private:
+    static constexpr uint16_t kDefaultWriteTimeoutTicks{100}; /*!< Default maximum timeout when waiting for free buffer space */
+
+    FetapMixerInput input_; /*!< Mixer slot of the source */
+};
+
 }
 
 }
\ No newline at end of file
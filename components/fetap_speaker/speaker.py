@@ -1,28 +1,86 @@
 from esphome import pins
 import esphome.codegen as cg
-from esphome.components import speaker
+from esphome.components import fetap_dsp, speaker
 import esphome.config_validation as cv
 from esphome.const import (
     CONF_ID,
+    CONF_PRIORITY,
 )
 
+AUTO_LOAD = ["fetap_dsp"]
+
 CONF_I2S_LRCLK_PIN = "i2s_lrclk_pin"
 CONF_I2S_BCLK_PIN = "i2s_bclk_pin"
 CONF_I2S_DOUT_PIN = "i2s_dout_pin"
+CONF_FETAP_I2S_ID = "fetap_i2s_id"
+CONF_DUCKING = "ducking"
+CONF_SOURCES = "sources"
+CONF_GAIN = "gain"
 
 fetap_ns = cg.esphome_ns.namespace("fetap")
 FetapMicrophone = fetap_ns.class_(
     "FetapSpeaker", speaker.Speaker, cg.Component
     )
+FetapSpeakerSource = fetap_ns.class_("FetapSpeakerSource", speaker.Speaker)
+FetapI2S = fetap_ns.class_("FetapI2S", cg.Component)
+
+I2S_PINS = [CONF_I2S_LRCLK_PIN, CONF_I2S_BCLK_PIN, CONF_I2S_DOUT_PIN]
+
+
+def validate_i2s_bus(config):
+    # Either the speaker owns its own TX channel (pins given) or it uses
+    # the TX half of a fetap_i2s full-duplex channel pair (pins given there)
+    if CONF_FETAP_I2S_ID in config:
+        for pin in I2S_PINS:
+            if pin in config:
+                raise cv.Invalid(
+                    f"{pin} must be configured on the fetap_i2s component when {CONF_FETAP_I2S_ID} is used"
+                )
+    else:
+        for pin in I2S_PINS:
+            if pin not in config:
+                raise cv.Invalid(f"{pin} is required when {CONF_FETAP_I2S_ID} is not used")
+    return config
+
+
+# Play() and every source have one mixer slot, at most 8 slots are available
+MAX_SOURCES = 7
+
+
+def gain_q12(gain_db):
+    return int(round(10 ** (gain_db / 20) * (1 << 12)))
 
-CONFIG_SCHEMA = cv.Schema(
+
+SOURCE_SCHEMA = cv.Schema(
     {
-        cv.GenerateID(): cv.declare_id(FetapMicrophone),
-        cv.Required(CONF_I2S_LRCLK_PIN): pins.internal_gpio_output_pin_number,
-        cv.Required(CONF_I2S_BCLK_PIN): pins.internal_gpio_output_pin_number,
-        cv.Required(CONF_I2S_DOUT_PIN): pins.internal_gpio_output_pin_number,
+        cv.GenerateID(): cv.declare_id(FetapSpeakerSource),
+        # Sources with lower priority are ducked while a source with higher priority plays
+        cv.Optional(CONF_PRIORITY, default=0): cv.int_range(min=0, max=255),
+        # Gain in dB
+        cv.Optional(CONF_GAIN, default=0.0): cv.float_range(min=-40.0, max=12.0),
     }
-).extend(cv.COMPONENT_SCHEMA)
+)
+
+CONFIG_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.declare_id(FetapMicrophone),
+            cv.Optional(CONF_FETAP_I2S_ID): cv.use_id(FetapI2S),
+            cv.Optional(fetap_dsp.CONF_PROCESSING, default=[]): fetap_dsp.PROCESSING_SCHEMA,
+            # Priority of the audio played on the speaker itself, e.g. by the voice assistant
+            cv.Optional(CONF_PRIORITY, default=0): cv.int_range(min=0, max=255),
+            # Gain in dB applied to ducked sources
+            cv.Optional(CONF_DUCKING, default=-20.0): cv.float_range(min=-60.0, max=0.0),
+            cv.Optional(CONF_SOURCES, default=[]): cv.All(
+                cv.ensure_list(SOURCE_SCHEMA), cv.Length(max=MAX_SOURCES)
+            ),
+            cv.Optional(CONF_I2S_LRCLK_PIN): pins.internal_gpio_output_pin_number,
+            cv.Optional(CONF_I2S_BCLK_PIN): pins.internal_gpio_output_pin_number,
+            cv.Optional(CONF_I2S_DOUT_PIN): pins.internal_gpio_output_pin_number,
+        }
+    ).extend(cv.COMPONENT_SCHEMA),
+    validate_i2s_bus,
+)
 
 
 async def to_code(config):
@@ -30,6 +88,30 @@ async def to_code(config):
     await speaker.register_speaker(var, config)
     await cg.register_component(var, config)
 
-    cg.add(var.set_dout_pin(config[CONF_I2S_DOUT_PIN]))
-    cg.add(var.set_bclk_pin(config[CONF_I2S_BCLK_PIN]))
-    cg.add(var.set_lrclk_pin(config[CONF_I2S_LRCLK_PIN]))
\ No newline at end of file
+    cg.add(var.set_priority(config[CONF_PRIORITY]))
+    cg.add(var.set_duck_gain(gain_q12(config[CONF_DUCKING])))
+
+    # Every source is a speaker of its own that other components can play on
+    for source_config in config[CONF_SOURCES]:
+        source = cg.new_Pvariable(source_config[CONF_ID])
+        await speaker.register_speaker(source, source_config)
+        cg.add(source.set_priority(source_config[CONF_PRIORITY]))
+        cg.add(source.set_gain(gain_q12(source_config[CONF_GAIN])))
+        cg.add(var.add_source(source))
+
+    if CONF_FETAP_I2S_ID in config:
+        parent = await cg.get_variable(config[CONF_FETAP_I2S_ID])
+        cg.add(var.set_parent(parent))
+    else:
+        cg.add(var.set_dout_pin(config[CONF_I2S_DOUT_PIN]))
+        cg.add(var.set_bclk_pin(config[CONF_I2S_BCLK_PIN]))
+        cg.add(var.set_lrclk_pin(config[CONF_I2S_LRCLK_PIN]))
+
+    # The processing stages are compiled into the sample loop, stages that are
+    # not listed do not exist in the binary. The define names a type, so it is
+    # emitted as a raw expression instead of a string literal.
+    if config[fetap_dsp.CONF_PROCESSING]:
+        cg.add_define(
+            "FETAP_SPEAKER_DSP_CHAIN",
+            cg.RawExpression(fetap_dsp.chain_type(config[fetap_dsp.CONF_PROCESSING])),
+        )
@@ -0,0 +1,41 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.const import (
+    CONF_BUFFER_SIZE,
+    CONF_ID,
+)
+
+CONF_FETAP_TRACE_ID = "fetap_trace_id"
+CONF_SINK = "sink"
+CONF_PARTITION = "partition"
+
+fetap_ns = cg.esphome_ns.namespace("fetap")
+FetapTrace = fetap_ns.class_("FetapTrace", cg.Component)
+Sink = FetapTrace.enum("Sink", is_class=True)
+
+SINKS = {
+    "logger": Sink.LOGGER,
+    "partition": Sink.PARTITION,
+}
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(FetapTrace),
+        cv.Optional(CONF_SINK, default="logger"): cv.enum(SINKS, lower=True),
+        # Label of a data partition in the custom partition table
+        cv.Optional(CONF_PARTITION, default="fetap_trace"): cv.string_strict,
+        cv.Optional(CONF_BUFFER_SIZE, default=8192): cv.int_range(min=512, max=65536),
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+
+async def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    await cg.register_component(var, config)
+
+    # The fetap microphone and dial sensor only include the trace recorder if it is configured
+    cg.add_define("USE_FETAP_TRACE")
+
+    cg.add(var.set_sink(config[CONF_SINK]))
+    cg.add(var.set_partition_label(config[CONF_PARTITION]))
+    cg.add(var.set_buffer_size(config[CONF_BUFFER_SIZE]))
@@ -0,0 +1,216 @@
+#include "fetap_trace.h"
+
+#include <algorithm>
+
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+
+namespace fetap {
+
+static const char *const TAG = "fetap.trace";
+
+void FetapTrace::setup(void) {
+    if (sink_ == Sink::PARTITION) {
+        partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label_.c_str());
+        if (partition_ == nullptr) {
+            ESP_LOGE(TAG, "Trace partition '%s' not found", partition_label_.c_str());
+            mark_failed();
+            status_set_error();
+            return;
+        }
+
+        // Append to the trace of the previous boot, the HEADER record marks the reboot
+        partition_offset_ = find_partition_end_();
+        partition_erased_ = (partition_offset_ + kFlashSectorSize - 1) / kFlashSectorSize * kFlashSectorSize;
+        partition_full_ = partition_offset_ >= partition_->size;
+    }
+
+    stream_buffer_ = xStreamBufferCreate(buffer_size_, 1);
+    mutex_ = xSemaphoreCreateMutex();
+    if (stream_buffer_ == nullptr || mutex_ == nullptr) {
+        ESP_LOGE(TAG, "Error allocating trace buffer");
+        mark_failed();
+        status_set_error();
+        return;
+    }
+
+    scratch_.resize(FetapTraceEncoder::kMaxRecordOverhead + FetapTraceEncoder::max_audio_size(kMaxAudioChunkSamples));
+    drain_buffer_.resize(std::max(kLoggerChunkSize, kPartitionChunkSize));
+
+    write_record_(0, [](FetapTraceEncoder &encoder, uint8_t *out) { return encoder.encode_header(out); });
+
+    ESP_LOGI(TAG, "Fetap Trace initialized successfully.");
+}
+
+void FetapTrace::loop(void) {
+    if (stream_buffer_ == nullptr) {
+        return;
+    }
+
+    switch (sink_) {
+        case Sink::LOGGER:
+            drain_to_logger_();
+            break;
+        case Sink::PARTITION:
+            drain_to_partition_();
+            break;
+    }
+}
+
+void FetapTrace::record_dial_edge(int64_t timestamp_us, bool level) {
+    write_record_(timestamp_us, [timestamp_us, level](FetapTraceEncoder &encoder, uint8_t *out) {
+        return encoder.encode_dial_edge(out, timestamp_us, level);
+    });
+}
+
+void FetapTrace::record_dial_digit(int64_t timestamp_us, char digit) {
+    write_record_(timestamp_us, [timestamp_us, digit](FetapTraceEncoder &encoder, uint8_t *out) {
+        return encoder.encode_dial_digit(out, timestamp_us, digit);
+    });
+}
+
+void FetapTrace::record_audio_block(int64_t timestamp_us, const int32_t *samples, size_t n_samples) {
+    // Large blocks are split so the scratch buffer has a fixed size. All chunks carry the
+    // timestamp of the block, the replay tool concatenates them.
+    for (size_t offset = 0; offset < n_samples; offset += kMaxAudioChunkSamples) {
+        const int32_t *chunk = samples + offset;
+        const size_t n_chunk = std::min(kMaxAudioChunkSamples, n_samples - offset);
+        write_record_(timestamp_us, [timestamp_us, chunk, n_chunk](FetapTraceEncoder &encoder, uint8_t *out) {
+            return encoder.encode_audio(out, timestamp_us, chunk, n_chunk);
+        });
+    }
+}
+
+void FetapTrace::record_dropped(uint32_t n_records) {
+    if (stream_buffer_ == nullptr || n_records == 0) {
+        return;
+    }
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    pending_gap_ += n_records;
+    dropped_count_.fetch_add(n_records, std::memory_order_relaxed);
+    xSemaphoreGive(mutex_);
+}
+
+void FetapTrace::clear(void) {
+    if (stream_buffer_ == nullptr) {
+        return;
+    }
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+    xStreamBufferReset(stream_buffer_);
+    pending_gap_ = 0;
+    if (partition_ != nullptr) {
+        const esp_err_t err = esp_partition_erase_range(partition_, 0, partition_->size);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Error erasing trace partition: %s", esp_err_to_name(err));
+            status_set_warning();
+        }
+        partition_offset_ = 0;
+        partition_erased_ = partition_->size;
+        partition_full_ = false;
+    }
+    xSemaphoreGive(mutex_);
+
+    write_record_(0, [](FetapTraceEncoder &encoder, uint8_t *out) { return encoder.encode_header(out); });
+    ESP_LOGI(TAG, "Trace cleared.");
+}
+
+template<typename F>
+void FetapTrace::write_record_(int64_t timestamp_us, F &&encode) {
+    if (stream_buffer_ == nullptr) {
+        return;
+    }
+
+    xSemaphoreTake(mutex_, portMAX_DELAY);
+
+    // Encode with a copy of the encoder state so a dropped record does not
+    // shift the timestamp base of the following records
+    FetapTraceEncoder encoder = encoder_;
+    size_t size{0};
+    if (pending_gap_ > 0) {
+        size += encoder.encode_gap(scratch_.data(), timestamp_us, pending_gap_);
+    }
+    size += encode(encoder, scratch_.data() + size);
+
+    if (xStreamBufferSpacesAvailable(stream_buffer_) >= size) {
+        xStreamBufferSend(stream_buffer_, scratch_.data(), size, 0);
+        encoder_ = encoder;
+        pending_gap_ = 0;
+    } else {
+        pending_gap_++;
+        dropped_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    xSemaphoreGive(mutex_);
+}
+
+void FetapTrace::drain_to_logger_(void) {
+    // The replay tool picks up all lines starting with "T:" from a captured log
+    for (size_t line = 0; line < kMaxLoggerLinesPerLoop; line++) {
+        const size_t n_bytes = xStreamBufferReceive(stream_buffer_, drain_buffer_.data(), kLoggerChunkSize, 0);
+        if (n_bytes == 0) {
+            return;
+        }
+        ESP_LOGI(TAG, "T:%s", base64_encode(drain_buffer_.data(), n_bytes).c_str());
+    }
+}
+
+void FetapTrace::drain_to_partition_(void) {
+    const size_t n_bytes = xStreamBufferReceive(stream_buffer_, drain_buffer_.data(), kPartitionChunkSize, 0);
+    if (n_bytes == 0 || partition_full_) {
+        return;
+    }
+
+    if (partition_offset_ + n_bytes > partition_->size) {
+        ESP_LOGW(TAG, "Trace partition is full, further records are discarded");
+        partition_full_ = true;
+        return;
+    }
+
+    // Erase sector by sector ahead of the write position instead of erasing the
+    // whole partition at once, which would block the main loop for seconds
+    while (partition_erased_ < partition_offset_ + n_bytes) {
+        const esp_err_t err = esp_partition_erase_range(partition_, partition_erased_, kFlashSectorSize);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Error erasing trace partition: %s", esp_err_to_name(err));
+            status_set_warning();
+            partition_full_ = true;
+            return;
+        }
+        partition_erased_ += kFlashSectorSize;
+    }
+
+    const esp_err_t err = esp_partition_write(partition_, partition_offset_, drain_buffer_.data(), n_bytes);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error writing trace partition: %s", esp_err_to_name(err));
+        status_set_warning();
+        return;
+    }
+    partition_offset_ += n_bytes;
+}
+
+size_t FetapTrace::find_partition_end_(void) {
+    // No record ends with an 0xFF byte, so the trace ends after the last byte that is not erased
+    uint8_t chunk[256];
+    size_t end = partition_->size;
+    while (end > 0) {
+        const size_t start = end > sizeof(chunk) ? end - sizeof(chunk) : 0;
+        if (esp_partition_read(partition_, start, chunk, end - start) != ESP_OK) {
+            return partition_->size;
+        }
+        for (size_t i = end - start; i > 0; i--) {
+            if (chunk[i - 1] != 0xFF) {
+                return start + i;
+            }
+        }
+        end = start;
+    }
+    return 0;
+}
+
+}
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <esp_partition.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+
+#include "esphome/core/component.h"
+
+#include "fetap_trace_format.h"
+
+namespace esphome {
+namespace fetap {
+
+/*
+    The fetap trace component records DIAL pin edges and raw microphone blocks into a compact binary trace
+    (see fetap_trace_format.h) that can be replayed on the host with tools/fetap_replay. Records are encoded
+    by the recording tasks into a stream buffer and written to the configured sink from the main loop.
+*/
+class FetapTrace : public Component {
+public:
+
+    /*
+        Possible destinations of the trace
+    */
+    enum class Sink : uint8_t {
+        LOGGER, /*!< base64 encoded lines on the logger */
+        PARTITION, /*!< a raw data partition in flash */
+    };
+
+    /* --------------------------- Functions inherited from component interface --------------------------- */
+
+    /*
+        Called initially to allocate the stream buffer and locate the flash partition
+    */
+    void setup(void) override;
+
+    /*
+        Called repeatedly, writes the encoded records to the sink
+    */
+    void loop(void) override;
+
+    /*
+        The stream buffer needs to be available before the recording components are set up
+
+        \returns    The bus setup priority
+    */
+    float get_setup_priority() const override { return setup_priority::BUS; }
+
+    /* --------------------------- Functions used by the recording components --------------------------- */
+
+    /*
+        Records a level change of the DIAL pin. Must not be called from an ISR.
+
+        \param  timestamp_us    Time of the level change (esp_timer_get_time())
+        \param  level           Level of the DIAL pin after the change
+    */
+    void record_dial_edge(int64_t timestamp_us, bool level);
+
+    /*
+        Records a digit published by the dial sensor
+
+        \param  timestamp_us    Time at which the digit was decoded
+        \param  digit           The dialed digit
+    */
+    void record_dial_digit(int64_t timestamp_us, char digit);
+
+    /*
+        Records a block of raw 32 bit I2S samples
+
+        \param  timestamp_us    Time at which the block was read
+        \param  samples         The raw samples
+        \param  n_samples       Number of samples
+    */
+    void record_audio_block(int64_t timestamp_us, const int32_t *samples, size_t n_samples);
+
+    /*
+        Reports records that a recording component had to drop before they reached the trace, e.g. edges
+        that did not fit into the queue of an ISR. They are counted in the GAP record in front of the next
+        record, like records dropped by the trace itself.
+
+        \param  n_records   Number of dropped records
+    */
+    void record_dropped(uint32_t n_records);
+
+    /*
+        \returns    Number of records that were dropped because the sink or a recording component could
+                    not keep up
+    */
+    uint32_t get_dropped_count(void) const { return dropped_count_.load(std::memory_order_relaxed); }
+
+    /*
+        Erases the flash partition of the partition sink and starts a new trace. Blocks until the
+        partition is erased.
+    */
+    void clear(void);
+
+    /* --------------------------- Functions triggered from code generation --------------------------- */
+
+    /*
+        Sets the destination of the trace
+
+        \param  sink    The sink
+    */
+    void set_sink(Sink sink) { sink_ = sink; }
+
+    /*
+        Sets the label of the data partition used by the partition sink
+
+        \param  label   The partition label
+    */
+    void set_partition_label(const std::string &label) { partition_label_ = label; }
+
+    /*
+        Sets the size of the stream buffer between the recording tasks and the sink
+
+        \param  size    Size in bytes
+    */
+    void set_buffer_size(int size) { buffer_size_ = static_cast<size_t>(size); }
+
+private:
+    static constexpr size_t kMaxAudioChunkSamples{128}; /*!< Audio blocks are split into records of at most this many samples */
+    static constexpr size_t kLoggerChunkSize{96}; /*!< Number of trace bytes per logger line */
+    static constexpr size_t kMaxLoggerLinesPerLoop{4}; /*!< Limits the time spent logging in a single loop iteration */
+    static constexpr size_t kPartitionChunkSize{512}; /*!< Number of trace bytes per flash write */
+    static constexpr size_t kFlashSectorSize{4096}; /*!< Erase granularity of the flash */
+
+    /*
+        Encodes a record with the given function and appends it to the stream buffer. If the record
+        does not fit, it is dropped and a GAP record is written in front of the next record that fits.
+
+        \param  timestamp_us    Timestamp of the record, also used for the GAP record
+        \param  encode          Function encoding the record with the given encoder into the given buffer,
+                                returns the record size
+    */
+    template<typename F>
+    void write_record_(int64_t timestamp_us, F &&encode);
+
+    /*
+        Writes pending trace bytes to the logger
+    */
+    void drain_to_logger_(void);
+
+    /*
+        Writes pending trace bytes to the flash partition
+    */
+    void drain_to_partition_(void);
+
+    /*
+        Finds the end of the trace already stored in the partition, so a reboot appends to it
+
+        \returns    Offset of the first byte after the stored trace
+    */
+    size_t find_partition_end_(void);
+
+    Sink sink_{Sink::LOGGER}; /*!< Destination of the trace */
+    std::string partition_label_{"fetap_trace"}; /*!< Label of the data partition for the partition sink */
+    size_t buffer_size_{8192}; /*!< Size of the stream buffer */
+    StreamBufferHandle_t stream_buffer_{nullptr}; /*!< Encoded records waiting for the sink */
+    SemaphoreHandle_t mutex_{nullptr}; /*!< Serializes encoding and writing from multiple tasks */
+    FetapTraceEncoder encoder_; /*!< Encoder state, guarded by mutex_ */
+    std::vector<uint8_t> scratch_; /*!< Encoding buffer, guarded by mutex_ */
+    uint32_t pending_gap_{0}; /*!< Records dropped since the last written record, guarded by mutex_ */
+    std::atomic<uint32_t> dropped_count_{0}; /*!< Total number of dropped records */
+    std::vector<uint8_t> drain_buffer_; /*!< Bytes read from the stream buffer by the sink */
+    const esp_partition_t *partition_{nullptr}; /*!< Data partition of the partition sink */
+    size_t partition_offset_{0}; /*!< Next write offset in the partition */
+    size_t partition_erased_{0}; /*!< Offset up to which the partition is erased */
+    bool partition_full_{false}; /*!< True once the partition has no space left */
+};
+
+}
+}
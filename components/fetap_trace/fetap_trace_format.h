@@ -0,0 +1,277 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace fetap {
+
+/*
+    Compact binary trace format for recording the DIAL pin and the raw microphone data in the field and
+    replaying it on the host. A trace is a sequence of records:
+
+        type (1 byte) | timestamp delta (zigzag varint, microseconds to the previous record) | payload
+
+    Payloads:
+        HEADER      "FTRC" and the format version (1 byte), resets the timestamp base to 0
+        DIAL_LOW    none, the DIAL pin changed to LOW (contact closed)
+        DIAL_HIGH   none, the DIAL pin changed to HIGH (contact open)
+        DIAL_DIGIT  the digit published by the device (1 byte, ASCII)
+        AUDIO       number of samples (varint), shift (1 byte), then for each raw 32 bit I2S sample
+                    the difference to the previous sample (zigzag varint) after shifting it right by
+                    shift. The shift is the number of trailing zero bits common to all samples of the
+                    block, so the encoding is lossless.
+        GAP         number of records that were dropped before this record (varint)
+
+    Erased flash (0xFF) ends a trace. The header of this file does not depend on esp-idf or esphome,
+    so the same encoder and decoder are used on the device and by the host replay tool.
+*/
+
+enum class FetapTraceRecordType : uint8_t {
+    HEADER = 0x00,
+    DIAL_LOW = 0x01,
+    DIAL_HIGH = 0x02,
+    DIAL_DIGIT = 0x03,
+    AUDIO = 0x04,
+    GAP = 0x05,
+    END = 0xFF,
+};
+
+/*
+    Encodes records into caller provided buffers. The encoder keeps the timestamp of the last record,
+    so records have to be encoded in the order they are written to the trace.
+*/
+class FetapTraceEncoder {
+public:
+    static constexpr uint8_t kVersion{1}; /*!< Version of the trace format */
+    static constexpr size_t kMaxVarintSize{10}; /*!< Maximum size of a 64 bit varint */
+    static constexpr size_t kMaxRecordOverhead{2 + 2 * kMaxVarintSize}; /*!< Maximum size of a record without samples */
+
+    /*
+        \param  n_samples   Number of samples of an audio block
+
+        \returns    Buffer size needed to encode an audio block with n_samples samples
+    */
+    static constexpr size_t max_audio_size(size_t n_samples) { return kMaxRecordOverhead + n_samples * 5; }
+
+    /*
+        The encode functions write a single record to out and return its size in bytes. out needs to
+        hold at least kMaxRecordOverhead bytes, or max_audio_size() bytes for audio records.
+    */
+    size_t encode_header(uint8_t *out) {
+        size_t pos = encode_type_(out, FetapTraceRecordType::HEADER, 0);
+        out[pos++] = 'F';
+        out[pos++] = 'T';
+        out[pos++] = 'R';
+        out[pos++] = 'C';
+        out[pos++] = kVersion;
+        last_timestamp_us_ = 0;
+        return pos;
+    }
+
+    size_t encode_dial_edge(uint8_t *out, int64_t timestamp_us, bool level) {
+        return encode_type_(out, level ? FetapTraceRecordType::DIAL_HIGH : FetapTraceRecordType::DIAL_LOW, timestamp_us);
+    }
+
+    size_t encode_dial_digit(uint8_t *out, int64_t timestamp_us, char digit) {
+        size_t pos = encode_type_(out, FetapTraceRecordType::DIAL_DIGIT, timestamp_us);
+        out[pos++] = static_cast<uint8_t>(digit);
+        return pos;
+    }
+
+    size_t encode_audio(uint8_t *out, int64_t timestamp_us, const int32_t *samples, size_t n_samples) {
+        uint32_t bits{0};
+        for (size_t i = 0; i < n_samples; i++) {
+            bits |= static_cast<uint32_t>(samples[i]);
+        }
+        uint8_t shift{0};
+        while (shift < 31 && bits != 0 && (bits & (1u << shift)) == 0) {
+            shift++;
+        }
+
+        size_t pos = encode_type_(out, FetapTraceRecordType::AUDIO, timestamp_us);
+        pos += encode_varint(out + pos, n_samples);
+        out[pos++] = shift;
+        int32_t previous{0};
+        for (size_t i = 0; i < n_samples; i++) {
+            const int32_t sample = samples[i] >> shift;
+            pos += encode_varint(out + pos, zigzag(static_cast<int64_t>(sample) - previous));
+            previous = sample;
+        }
+        return pos;
+    }
+
+    size_t encode_gap(uint8_t *out, int64_t timestamp_us, uint32_t n_dropped) {
+        size_t pos = encode_type_(out, FetapTraceRecordType::GAP, timestamp_us);
+        pos += encode_varint(out + pos, n_dropped);
+        return pos;
+    }
+
+    /*
+        Maps signed values to unsigned values so that small magnitudes get short varints
+    */
+    static uint64_t zigzag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+
+    /*
+        Writes value as LEB128 varint (7 bits per byte, least significant group first)
+
+        \returns    Number of bytes written
+    */
+    static size_t encode_varint(uint8_t *out, uint64_t value) {
+        size_t pos{0};
+        while (value >= 0x80) {
+            out[pos++] = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        out[pos++] = static_cast<uint8_t>(value);
+        return pos;
+    }
+
+private:
+    size_t encode_type_(uint8_t *out, FetapTraceRecordType type, int64_t timestamp_us) {
+        out[0] = static_cast<uint8_t>(type);
+        const size_t pos = 1 + encode_varint(out + 1, zigzag(timestamp_us - last_timestamp_us_));
+        last_timestamp_us_ = timestamp_us;
+        return pos;
+    }
+
+    int64_t last_timestamp_us_{0}; /*!< Timestamp of the last encoded record */
+};
+
+/*
+    A decoded trace record. Only the fields of the record type are valid.
+*/
+struct FetapTraceRecord {
+    FetapTraceRecordType type{FetapTraceRecordType::END}; /*!< Type of the record */
+    int64_t timestamp_us{0}; /*!< Absolute timestamp of the record */
+    char digit{0}; /*!< Digit of a DIAL_DIGIT record */
+    uint32_t n_dropped{0}; /*!< Dropped records of a GAP record */
+    std::vector<int32_t> samples; /*!< Raw 32 bit I2S samples of an AUDIO record */
+};
+
+/*
+    Decodes the records of a trace from a buffer
+*/
+class FetapTraceDecoder {
+public:
+    FetapTraceDecoder(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+    /*
+        Decodes the next record
+
+        \param  record  Filled with the decoded record
+
+        \returns    False at the end of the trace or if the trace is malformed (see is_malformed())
+    */
+    bool next(FetapTraceRecord &record) {
+        if (pos_ >= size_ || data_[pos_] == static_cast<uint8_t>(FetapTraceRecordType::END)) {
+            return false;
+        }
+
+        record.type = static_cast<FetapTraceRecordType>(data_[pos_++]);
+        uint64_t delta{0};
+        if (!decode_varint_(delta)) {
+            return false;
+        }
+        record.timestamp_us = last_timestamp_us_ + unzigzag(delta);
+        last_timestamp_us_ = record.timestamp_us;
+
+        switch (record.type) {
+            case FetapTraceRecordType::HEADER:
+                if (size_ - pos_ < 5 || data_[pos_] != 'F' || data_[pos_ + 1] != 'T' || data_[pos_ + 2] != 'R' || data_[pos_ + 3] != 'C'
+                    || data_[pos_ + 4] != FetapTraceEncoder::kVersion) {
+                    return fail_();
+                }
+                pos_ += 5;
+                last_timestamp_us_ = 0;
+                return true;
+            case FetapTraceRecordType::DIAL_LOW:
+            case FetapTraceRecordType::DIAL_HIGH:
+                return true;
+            case FetapTraceRecordType::DIAL_DIGIT:
+                if (pos_ >= size_) {
+                    return fail_();
+                }
+                record.digit = static_cast<char>(data_[pos_++]);
+                return true;
+            case FetapTraceRecordType::AUDIO: {
+                uint64_t n_samples{0};
+                if (!decode_varint_(n_samples) || pos_ >= size_) {
+                    return fail_();
+                }
+                const uint8_t shift = data_[pos_++];
+                // Every sample takes at least one byte, so a corrupt count is caught before it is allocated
+                if (n_samples > size_ - pos_ || shift >= 32) {
+                    return fail_();
+                }
+                record.samples.resize(n_samples);
+                int64_t previous{0};
+                for (uint64_t i = 0; i < n_samples; i++) {
+                    uint64_t value{0};
+                    if (!decode_varint_(value)) {
+                        return false;
+                    }
+                    previous += unzigzag(value);
+                    record.samples[i] = static_cast<int32_t>(static_cast<uint32_t>(previous) << shift);
+                }
+                return true;
+            }
+            case FetapTraceRecordType::GAP: {
+                uint64_t n_dropped{0};
+                if (!decode_varint_(n_dropped)) {
+                    return false;
+                }
+                record.n_dropped = static_cast<uint32_t>(n_dropped);
+                return true;
+            }
+            default:
+                return fail_();
+        }
+    }
+
+    /*
+        \returns    True if decoding stopped because of malformed data
+    */
+    bool is_malformed(void) const { return malformed_; }
+
+    /*
+        \returns    Number of bytes decoded so far
+    */
+    size_t get_position(void) const { return pos_; }
+
+    /*
+        Reverses FetapTraceEncoder::zigzag()
+    */
+    static int64_t unzigzag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+private:
+    bool decode_varint_(uint64_t &value) {
+        value = 0;
+        for (uint8_t shift = 0; shift < 64; shift += 7) {
+            if (pos_ >= size_) {
+                return fail_();
+            }
+            const uint8_t byte = data_[pos_++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return fail_();
+    }
+
+    bool fail_(void) {
+        malformed_ = true;
+        return false;
+    }
+
+    const uint8_t *data_; /*!< Trace data */
+    size_t size_; /*!< Size of the trace data */
+    size_t pos_{0}; /*!< Current decoding position */
+    int64_t last_timestamp_us_{0}; /*!< Timestamp of the last decoded record */
+    bool malformed_{false}; /*!< True if malformed data was encountered */
+};
+
+}
+}
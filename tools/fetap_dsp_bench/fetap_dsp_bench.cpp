@@ -0,0 +1,161 @@
+/*
+    Benchmarks the processing chain of the fetap_dsp component on the host. The same stages are run once
+    as the compile-time Chain the microphone and speaker use and once behind a per-stage virtual interface,
+    both over the same synthetic microphone signal. The outputs are compared sample by sample and the time
+    per sample of both variants is printed.
+
+    Build from the repository root:
+
+        g++ -std=c++17 -O2 -I components tools/fetap_dsp_bench/fetap_dsp_bench.cpp -o fetap_dsp_bench
+
+    The default stages correspond to the processing example in fetap32.yaml (dc_block 0.995, high_pass
+    100Hz, gain 6, limiter -1/50ms). To benchmark the stages of another configuration, pass the template
+    arguments of the chain type that the code generation writes to FETAP_MICROPHONE_DSP_CHAIN in
+    esphome/core/defines.h, e.g.
+
+        -D'FETAP_DSP_BENCH_STAGES=esphome::fetap::dsp::Gain<130762>'
+
+    Usage:
+
+        fetap_dsp_bench [--seconds N] [--repeat N]
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "fetap_dsp/fetap_dsp.h"
+
+#ifndef FETAP_DSP_BENCH_STAGES
+#define FETAP_DSP_BENCH_STAGES                                                                              \
+    esphome::fetap::dsp::DcBlock<32604>,                                                                    \
+    esphome::fetap::dsp::HighPass<261084055, -522168111, 261084055, -521966747, 253934019>,                 \
+    esphome::fetap::dsp::Gain<130762>,                                                                      \
+    esphome::fetap::dsp::Limiter<29205, 41>
+#endif
+
+using namespace esphome::fetap;
+
+static constexpr int kSampleRate{16000};
+
+/*
+    Processing stage behind a virtual interface, the way a runtime configurable chain would be built
+*/
+class VirtualStage {
+public:
+    virtual ~VirtualStage() = default;
+    virtual int32_t process(int32_t sample) = 0;
+};
+
+template<typename Stage>
+class VirtualStageAdapter : public VirtualStage {
+public:
+    int32_t process(int32_t sample) override { return stage_.process(sample); }
+
+private:
+    Stage stage_; /*!< The wrapped stage */
+};
+
+/*
+    Runs the given stages one after another through virtual calls
+*/
+template<typename... Stages>
+class VirtualChain {
+public:
+    VirtualChain() { (stages_.emplace_back(new VirtualStageAdapter<Stages>()), ...); }
+
+    int32_t process(int32_t sample) {
+        for (const std::unique_ptr<VirtualStage> &stage : stages_) {
+            sample = stage->process(sample);
+        }
+        return sample;
+    }
+
+private:
+    std::vector<std::unique_ptr<VirtualStage>> stages_; /*!< The stages in the order they are applied */
+};
+
+/*
+    Generates raw 32 bit INMP441 samples: a tone with a DC offset, a low frequency rumble, noise and loud
+    bursts that drive the limiter
+*/
+static std::vector<int32_t> generate_signal(size_t n_samples) {
+    std::vector<int32_t> raw(n_samples);
+    uint32_t lcg{12345};
+    int32_t phase_tone{0};
+    int32_t phase_rumble{0};
+    for (size_t i = 0; i < n_samples; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        // Triangle waves keep the generator free of floating point and libm differences between hosts
+        phase_tone = (phase_tone + 2621) & 0xFFFF; // ~640 Hz
+        phase_rumble = (phase_rumble + 123) & 0xFFFF; // ~30 Hz
+        const int32_t tone = (phase_tone < 0x8000 ? phase_tone : 0xFFFF - phase_tone) - 0x4000;
+        const int32_t rumble = (phase_rumble < 0x8000 ? phase_rumble : 0xFFFF - phase_rumble) - 0x4000;
+        const bool burst = (i / kSampleRate) % 3 == 2;
+        const int32_t sample = 800 + (burst ? tone : tone / 8) + rumble / 4 + static_cast<int32_t>(lcg >> 24) - 128;
+        raw[i] = sample * (1 << 13);
+    }
+    return raw;
+}
+
+template<typename ChainT>
+static double run(const std::vector<int32_t> &raw, std::vector<int16_t> &out, int repeat) {
+    double best_ns{0.0};
+    for (int r = 0; r < repeat; r++) {
+        ChainT chain;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < raw.size(); i++) {
+            out[i] = dsp::process_microphone_sample(chain, raw[i]);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count() / raw.size();
+        if (r == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+    return best_ns;
+}
+
+int main(int argc, char **argv) {
+    int seconds{60};
+    int repeat{5};
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--seconds N] [--repeat N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seconds <= 0 || repeat <= 0) {
+        fprintf(stderr, "--seconds and --repeat have to be positive\n");
+        return 2;
+    }
+
+    const std::vector<int32_t> raw = generate_signal(static_cast<size_t>(seconds) * kSampleRate);
+    std::vector<int16_t> fused_out(raw.size());
+    std::vector<int16_t> virtual_out(raw.size());
+
+    const double fused_ns = run<dsp::Chain<FETAP_DSP_BENCH_STAGES>>(raw, fused_out, repeat);
+    const double virtual_ns = run<VirtualChain<FETAP_DSP_BENCH_STAGES>>(raw, virtual_out, repeat);
+
+    size_t n_mismatches{0};
+    for (size_t i = 0; i < raw.size(); i++) {
+        n_mismatches += fused_out[i] != virtual_out[i];
+    }
+
+    printf("stages   %zu, %d s of audio, best of %d\n", dsp::Chain<FETAP_DSP_BENCH_STAGES>::kNumStages, seconds, repeat);
+    printf("fused    %.2f ns/sample\n", fused_ns);
+    printf("virtual  %.2f ns/sample (%.2fx)\n", virtual_ns, virtual_ns / fused_ns);
+    if (n_mismatches > 0) {
+        printf("outputs differ in %zu samples\n", n_mismatches);
+        return 1;
+    }
+    printf("outputs identical\n");
+    return 0;
+}
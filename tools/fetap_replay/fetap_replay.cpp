@@ -0,0 +1,398 @@
+/*
+    Replays a trace recorded by the fetap_trace component on the host. DIAL pin edges are decoded with the
+    sampling scheme of the GPIO backend and the pulse counter of the RMT backend of the fetap dial sensor and
+    compared with the digits the device published (or the digits given with --expect). Raw microphone blocks
+    are run through the microphone sample conversion and processing chain as fast as possible to report
+    throughput and signal statistics.
+
+    Build from the repository root:
+
+        g++ -std=c++17 -O2 -I components tools/fetap_replay/fetap_replay.cpp -o fetap_replay
+
+    To replay the audio through the processing chain of a configuration, pass the chain type that the code
+    generation writes to FETAP_MICROPHONE_DSP_CHAIN in esphome/core/defines.h, e.g.
+
+        -D'FETAP_MICROPHONE_DSP_CHAIN=esphome::fetap::dsp::Chain<esphome::fetap::dsp::Gain<130762>>'
+
+    Usage:
+
+        fetap_replay [--expect DIGITS] [--repeat N] TRACE
+        fetap_replay --self-test
+
+    TRACE is either a binary trace read from the flash partition or a captured log of the logger sink.
+    --self-test records synthetic RMT captures of every digit, with and without contact bounce, into a trace
+    the way the dial sensor does and checks that both decoders read the digits back from it.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fetap_dial/fetap_dial_decoder.h"
+#include "fetap_dsp/fetap_dsp.h"
+#include "fetap_trace/fetap_trace_format.h"
+
+#ifndef FETAP_MICROPHONE_DSP_CHAIN
+#define FETAP_MICROPHONE_DSP_CHAIN esphome::fetap::dsp::Chain<>
+#endif
+
+using namespace esphome::fetap;
+
+static constexpr double kSampleRate{16000.0};
+
+/*
+    Recording between two HEADER records, i.e. of a single boot of the device
+*/
+struct Segment {
+    std::vector<FetapDialEdge> edges; /*!< Recorded DIAL pin edges */
+    std::string device_digits; /*!< Digits published by the device */
+    std::vector<int32_t> samples; /*!< Concatenated raw microphone samples */
+    std::vector<std::pair<int64_t, size_t>> blocks; /*!< Timestamp and size of every audio record */
+    uint32_t n_dropped{0}; /*!< Records dropped on the device */
+};
+
+static bool read_file(const char *path, std::string &content) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    content = stream.str();
+    return true;
+}
+
+static std::vector<uint8_t> base64_decode(const std::string &text) {
+    static const std::string kAlphabet{"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+    std::vector<uint8_t> out;
+    uint32_t bits{0};
+    int n_bits{0};
+    for (char c : text) {
+        const size_t value = kAlphabet.find(c);
+        if (value == std::string::npos) {
+            continue;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        n_bits += 6;
+        if (n_bits >= 8) {
+            n_bits -= 8;
+            out.push_back(static_cast<uint8_t>(bits >> n_bits));
+        }
+    }
+    return out;
+}
+
+/*
+    Extracts the trace bytes from the "T:<base64>" lines the logger sink writes
+*/
+static std::vector<uint8_t> extract_from_log(const std::string &log) {
+    std::vector<uint8_t> trace;
+    std::istringstream lines(log);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.find("fetap.trace") == std::string::npos) {
+            continue;
+        }
+        const size_t start = line.find("T:");
+        if (start == std::string::npos) {
+            continue;
+        }
+        // Strip the color reset sequence of the esphome logger at the end of the line
+        size_t end = line.find('\033', start);
+        const std::vector<uint8_t> bytes = base64_decode(line.substr(start + 2, end == std::string::npos ? std::string::npos : end - start - 2));
+        trace.insert(trace.end(), bytes.begin(), bytes.end());
+    }
+    return trace;
+}
+
+static std::vector<Segment> decode_trace(const std::vector<uint8_t> &trace, bool &malformed) {
+    std::vector<Segment> segments(1);
+    FetapTraceDecoder decoder(trace.data(), trace.size());
+    FetapTraceRecord record;
+    while (decoder.next(record)) {
+        Segment &segment = segments.back();
+        switch (record.type) {
+            case FetapTraceRecordType::HEADER:
+                if (!segment.edges.empty() || !segment.samples.empty() || !segment.device_digits.empty()) {
+                    segments.emplace_back();
+                }
+                break;
+            case FetapTraceRecordType::DIAL_LOW:
+            case FetapTraceRecordType::DIAL_HIGH:
+                segment.edges.push_back({record.timestamp_us, record.type == FetapTraceRecordType::DIAL_HIGH});
+                break;
+            case FetapTraceRecordType::DIAL_DIGIT:
+                segment.device_digits += record.digit;
+                break;
+            case FetapTraceRecordType::AUDIO:
+                segment.blocks.emplace_back(record.timestamp_us, record.samples.size());
+                segment.samples.insert(segment.samples.end(), record.samples.begin(), record.samples.end());
+                break;
+            case FetapTraceRecordType::GAP:
+                segment.n_dropped += record.n_dropped;
+                break;
+            default:
+                break;
+        }
+    }
+    malformed = decoder.is_malformed();
+    return segments;
+}
+
+/*
+    Compares decoded digits position by position
+
+    \returns    Number of matching positions
+*/
+static size_t count_matches(const std::string &decoded, const std::string &reference) {
+    size_t matches{0};
+    for (size_t i = 0; i < decoded.size() && i < reference.size(); i++) {
+        matches += decoded[i] == reference[i];
+    }
+    return matches;
+}
+
+static void replay_dial(const std::vector<Segment> &segments, const char *expect) {
+    std::string sampled;
+    std::string pulse_train;
+    std::string device;
+    size_t n_edges{0};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const Segment &segment : segments) {
+        for (const FetapDialDigit &digit : fetap_dial_decode_sampled(segment.edges)) {
+            sampled += digit.digit;
+        }
+        device += segment.device_digits;
+        n_edges += segment.edges.size();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const Segment &segment : segments) {
+        for (const FetapDialDigit &digit : fetap_dial_decode_pulse_train(segment.edges)) {
+            pulse_train += digit.digit;
+        }
+    }
+
+    if (n_edges == 0) {
+        printf("dial:  no edges recorded\n");
+        return;
+    }
+
+    const std::string reference = expect != nullptr ? std::string(expect) : device;
+    printf("dial:  %zu edges decoded in %.3f ms\n", n_edges, seconds * 1e3);
+    printf("       %s %s\n", expect != nullptr ? "expected " : "device   ", reference.c_str());
+    for (const auto &decoded : {std::make_pair("gpio", &sampled), std::make_pair("rmt ", &pulse_train)}) {
+        const size_t matches = count_matches(*decoded.second, reference);
+        const size_t total = std::max(decoded.second->size(), reference.size());
+        printf("       %s      %s (%zu/%zu digits, %.1f %%)\n", decoded.first, decoded.second->c_str(), matches, total,
+               total > 0 ? 100.0 * matches / total : 100.0);
+    }
+}
+
+static void replay_audio(const std::vector<Segment> &segments, int repeat) {
+    size_t n_samples{0};
+    size_t n_late{0};
+    for (const Segment &segment : segments) {
+        n_samples += segment.samples.size();
+
+        // A block that was read later than the audio of the previous block lasts points
+        // to a stalled loop, which shows up as crackle on the device
+        for (size_t i = 1; i < segment.blocks.size(); i++) {
+            const int64_t expected_us = static_cast<int64_t>(segment.blocks[i - 1].second * 1e6 / kSampleRate);
+            if (segment.blocks[i].first - segment.blocks[i - 1].first > expected_us * 3 / 2 + 1000) {
+                n_late++;
+            }
+        }
+    }
+
+    if (n_samples == 0) {
+        printf("audio: no samples recorded\n");
+        return;
+    }
+
+    size_t n_clipped{0};
+    int32_t peak{0};
+    double energy{0.0};
+    double seconds{0.0};
+    for (int r = 0; r < repeat; r++) {
+        n_clipped = 0;
+        peak = 0;
+        energy = 0.0;
+        const auto start = std::chrono::steady_clock::now();
+        for (const Segment &segment : segments) {
+            FETAP_MICROPHONE_DSP_CHAIN chain;
+            for (int32_t raw : segment.samples) {
+                const int32_t sample = dsp::process_microphone_sample(chain, raw);
+                const int32_t magnitude = std::abs(sample);
+                n_clipped += magnitude >= INT16_MAX;
+                peak = std::max(peak, magnitude);
+                energy += static_cast<double>(sample) * sample;
+            }
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const double audio_seconds = n_samples / kSampleRate;
+    const double processed = static_cast<double>(n_samples) * repeat;
+    printf("audio: %zu samples (%.2f s), processed %d times in %.3f ms\n", n_samples, audio_seconds, repeat, seconds * 1e3);
+    printf("       throughput %.1f Msamples/s (%.0fx real time)\n", processed / seconds / 1e6, processed / kSampleRate / seconds);
+    printf("       peak %d, rms %.1f, clipped %zu, late blocks %zu\n", peak, std::sqrt(energy / n_samples), n_clipped, n_late);
+}
+
+/*
+    Symbol with the layout of rmt_symbol_word_t of the RMT driver
+*/
+struct RmtSymbol {
+    uint16_t duration0 : 15; /*!< Duration of the first level in ticks */
+    uint16_t level0 : 1; /*!< First level */
+    uint16_t duration1 : 15; /*!< Duration of the second level in ticks, 0 for the end marker */
+    uint16_t level1 : 1; /*!< Second level */
+};
+
+/*
+    Builds the symbols the RMT receiver captures for a digit: each pulse is open for kPulseOpenMilliseconds
+    and closed for kPulseClosedMilliseconds, the capture ends with the LOW end marker after the last pulse
+
+    \param  digit       The dialed digit
+    \param  bounce      True to add contact bounce when the contact opens and closes
+*/
+static std::vector<RmtSymbol> synthesize_rmt_capture(char digit, bool bounce) {
+    constexpr uint16_t kTicksPerMillisecond{200};
+    const int n_pulses = digit == '0' ? FetapDialTiming::kMaxPulses : digit - '0';
+
+    std::vector<RmtSymbol> symbols;
+    auto add = [&symbols](bool level, uint16_t ticks) {
+        if (symbols.empty() || symbols.back().duration1 != 0 || symbols.back().level1 == level) {
+            symbols.push_back({ticks, level, 0, !level});
+        } else {
+            symbols.back().duration1 = ticks;
+        }
+    };
+    for (int pulse = 0; pulse < n_pulses; pulse++) {
+        uint16_t open_ms = FetapDialTiming::kPulseOpenMilliseconds;
+        if (bounce) {
+            // Bounces of 0.5 ms when the contact opens and closes, each one is a symbol of its own
+            for (int i = 0; i < 3; i++) {
+                add(true, kTicksPerMillisecond / 2);
+                add(false, kTicksPerMillisecond / 2);
+            }
+            open_ms -= 3;
+        }
+        add(true, open_ms * kTicksPerMillisecond);
+        if (pulse + 1 < n_pulses) {
+            add(false, FetapDialTiming::kPulseClosedMilliseconds * kTicksPerMillisecond);
+        }
+    }
+    // End marker: the idle LOW level with duration 0
+    if (symbols.back().duration1 == 0 && symbols.back().level1 == 0) {
+        return symbols;
+    }
+    symbols.push_back({0, 0, 0, 0});
+    return symbols;
+}
+
+static int self_test(void) {
+    const std::string digits{"1234567890"};
+    FetapTraceEncoder encoder;
+    std::vector<uint8_t> trace(64);
+    size_t size = encoder.encode_header(trace.data());
+
+    // Same path as FetapDialSensor::handle_rmt_pulse_train: the edges are reconstructed from the captured
+    // symbols and recorded as DIAL edges, one digit every two seconds
+    int64_t done_us{0};
+    for (bool bounce : {false, true}) {
+        for (char digit : digits) {
+            done_us += 2000000;
+            const std::vector<RmtSymbol> symbols = synthesize_rmt_capture(digit, bounce);
+            fetap_dial_rmt_edges(symbols.data(), symbols.size(), 5, done_us, [&](int64_t timestamp_us, bool level) {
+                trace.resize(size + FetapTraceEncoder::kMaxRecordOverhead);
+                size += encoder.encode_dial_edge(trace.data() + size, timestamp_us, level);
+            });
+        }
+    }
+    trace.resize(size);
+
+    bool malformed{false};
+    const std::vector<Segment> segments = decode_trace(trace, malformed);
+    std::string sampled;
+    std::string pulse_train;
+    for (const FetapDialDigit &digit : fetap_dial_decode_sampled(segments.front().edges)) {
+        sampled += digit.digit;
+    }
+    for (const FetapDialDigit &digit : fetap_dial_decode_pulse_train(segments.front().edges)) {
+        pulse_train += digit.digit;
+    }
+
+    const std::string expected = digits + digits;
+    printf("self-test: expected %s\n", expected.c_str());
+    printf("           gpio     %s\n", sampled.c_str());
+    printf("           rmt      %s\n", pulse_train.c_str());
+    const bool passed = !malformed && sampled == expected && pulse_train == expected;
+    printf("           %s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    const char *expect{nullptr};
+    const char *path{nullptr};
+    int repeat{10};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--self-test") == 0) {
+            return self_test();
+        } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+            expect = argv[++i];
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path == nullptr) {
+        fprintf(stderr, "usage: %s [--expect DIGITS] [--repeat N] TRACE | --self-test\n", argv[0]);
+        return 2;
+    }
+
+    std::string content;
+    if (!read_file(path, content)) {
+        fprintf(stderr, "error: cannot read %s\n", path);
+        return 1;
+    }
+
+    // Binary traces start with a HEADER record, everything else is treated as a captured log
+    std::vector<uint8_t> trace;
+    if (!content.empty() && content[0] == static_cast<char>(FetapTraceRecordType::HEADER)) {
+        trace.assign(content.begin(), content.end());
+    } else {
+        trace = extract_from_log(content);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    bool malformed{false};
+    const std::vector<Segment> segments = decode_trace(trace, malformed);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t n_dropped{0};
+    for (const Segment &segment : segments) {
+        n_dropped += segment.n_dropped;
+    }
+    printf("trace: %zu bytes, %zu boot(s), decoded in %.3f ms (%.1f MB/s)%s\n", trace.size(), segments.size(), seconds * 1e3,
+           trace.size() / seconds / 1e6, malformed ? ", malformed data at the end" : "");
+    if (n_dropped > 0) {
+        printf("       %u records were dropped on the device\n", n_dropped);
+    }
+
+    replay_dial(segments, expect);
+    replay_audio(segments, repeat);
+    return malformed ? 1 : 0;
+}